@@ -20,6 +20,26 @@ set(DLL_SUFFIX ".so")
 # def
 add_definitions(-DASIO_HAS_EPOLL)
 
+if(NET_USE_PROTOBUF_ARENA)
+	# pb消息在线程arena上解析, 见net/tool/pb_arena.hpp
+	find_library(PROTOBUF_LIBRARY protobuf)
+	if(NOT PROTOBUF_LIBRARY)
+		message(FATAL_ERROR "NET_USE_PROTOBUF_ARENA requires libprotobuf")
+	endif()
+	add_definitions(-DNET_USE_PROTOBUF_ARENA)
+	if(NET_PROTOBUF_ARENA_BATCH)
+		add_definitions(-DNET_PROTOBUF_ARENA_BATCH)
+	endif()
+else()
+	set(PROTOBUF_LIBRARY "")
+endif()
+
+if(NET_NO_EXCEPTIONS)
+	# 关闭异常: 网络层全部走error_code, asio内部无法恢复的错误由asio::detail::throw_exception处理(见net/base/error.hpp)
+	add_definitions(-DNET_NO_EXCEPTIONS -DASIO_NO_EXCEPTIONS)
+	set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fno-exceptions")
+endif()
+
 # openssl
 # find_package(OpenSSL REQUIRED)
 # set(OPENSSL_LIBRARY ${OPENSSL_SSL_LIBRARY} ${OPENSSL_CRYPTO_LIBRARY})
@@ -29,9 +49,16 @@ set(OPENSSL_LIBRARY
     "${PROJECT_SOURCE_DIR}/3rd/lib/ubuntu/libcrypto.a")
 
 # zlib
-# find_package(ZLIB REQUIRED)
-set(ZLIB_INCLUDE_DIR "${PROJECT_SOURCE_DIR}/thirds/zlib/${LIBPROTOBUF_PLATFORM}/include")
-set(ZLIB_LIBRARIES "${PROJECT_SOURCE_DIR}/thirds/zlib/${LIBPROTOBUF_PLATFORM}/lib/libz.so")
+if(NET_USE_ZLIB)
+	# websocket permessage-deflate, 见net/opt/websocket/ws_deflate.hpp
+	find_library(ZLIB_LIBRARY z)
+	if(NOT ZLIB_LIBRARY)
+		message(FATAL_ERROR "NET_USE_ZLIB requires zlib")
+	endif()
+	add_definitions(-DNET_USE_ZLIB)
+else()
+	set(ZLIB_LIBRARY "")
+endif()
 
 # thread
 set(THREAD_LIBRARY pthread)
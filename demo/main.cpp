@@ -159,6 +159,52 @@ void test_msg_proxy() {
 	msgstrproxy->call("logout", (const char*)&msgtest, msglen, 12);
 }
 
+///////////////////忙轮询延迟测试///////////////////////////////////////////////////////
+// loopback单连接echo, 统计往返延迟的p50/p99, 对比阻塞模式和忙轮询模式.
+void test_echo_latency(bool busypoll, int rounds = 20000) {
+	TcpSvr svr(1);
+	TcpCli cli(1);
+	if (busypoll) {
+		BusyPoll policy;
+		policy.spin = 100000;
+		policy.sock_usec = 50;
+		svr.get_iopool().busy_poll({ 0 }, policy);
+		cli.get_iopool().busy_poll({ 0 }, policy);
+	}
+	std::vector<std::int64_t> rtts;
+	rtts.reserve(rounds);
+	std::promise<void> done;
+	auto last = std::chrono::steady_clock::now();
+	svr.bind(Event::recv, [](TcpSvr::session_ptr_type& ptr, std::string&& s) {
+		ptr->send(std::move(s));
+	});
+	cli.bind(Event::connect, [&](TcpCli::session_ptr_type& ptr, error_code ec) {
+		if (!ec) {
+			ptr->no_delay(true);
+			last = std::chrono::steady_clock::now();
+			ptr->send(std::string(64, 'a'));
+		}
+	});
+	cli.bind(Event::recv, [&](TcpCli::session_ptr_type& ptr, std::string&& s) {
+		auto now = std::chrono::steady_clock::now();
+		rtts.emplace_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count());
+		if (rtts.size() == static_cast<std::size_t>(rounds)) {
+			done.set_value();
+			return;
+		}
+		last = now;
+		ptr->send(std::move(s));
+	});
+	svr.start("127.0.0.1", "8890");
+	cli.start();
+	cli.add("127.0.0.1", "8890");
+	done.get_future().wait();
+
+	std::sort(rtts.begin(), rtts.end());
+	std::cout << (busypoll ? "busy poll" : "blocking") << " rtt p50: " << rtts[rtts.size() / 2] / 1000.0
+		<< "us, p99: " << rtts[rtts.size() * 99 / 100] / 1000.0 << "us" << std::endl;
+}
+
 //#include "help_type1.hpp"
 asio::io_context g_context_(1);
 asio::io_context::strand g_context_s_(g_context_);
@@ -196,6 +242,12 @@ int main(int argc, char * argv[]){
 //////////////////////////////websocket 不建议和tcp使用同一个端口//////////////////////////////////////////////
 	SvrProxy<WebsocketSvr> wssvr(4);
 	wssvr.start("0.0.0.0", "8889");
+	// client: connect事件在升级完成之后
+	CliProxy<WebsocketCli> wscli(4);
+	wscli.start();
+	for (int i = 0; i < 42; ++i) {
+		wscli.add("127.0.0.1", "8889", "/");
+	}
 //////////////////////////////ssl//////////////////////////////
 #ifdef NET_USE_SSL
 	// svr
@@ -215,6 +267,8 @@ int main(int argc, char * argv[]){
 #endif
 	
 	//test_msg_proxy();
+	//test_echo_latency(false);
+	//test_echo_latency(true);
 
 	auto io_worker = asio::make_work_guard(g_context_);
 	g_context_.run();
@@ -28,77 +28,82 @@ namespace net {
 		}
 
 		inline bool acceptor_start(std::string_view host, std::string_view port) {
-			try {
-				clear_last_error();
+			clear_last_error();
 
-				this->acceptor_.close(ec_ignore);
-				// parse address and port
-				asio::ip::tcp::resolver resolver(this->cio_.context());
-				asio::ip::tcp::endpoint endpoint = *resolver.resolve(host, port,
-					asio::ip::resolver_base::flags::passive | asio::ip::resolver_base::flags::address_configured).begin();
-
-				this->acceptor_.open(endpoint.protocol());
-				this->acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true)); // set port reuse
+			this->acceptor_.close(ec_ignore);
+			// parse address and port
+			error_code ec;
+			asio::ip::tcp::resolver resolver(this->cio_.context());
+			auto results = resolver.resolve(host, port,
+				asio::ip::resolver_base::flags::passive | asio::ip::resolver_base::flags::address_configured, ec);
+			if (!ec && results.empty())
+				ec = asio::error::host_not_found;
+			if (!ec) {
+				asio::ip::tcp::endpoint endpoint = *results.begin();
+				this->acceptor_.open(endpoint.protocol(), ec);
+				if (!ec)
+					this->acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true), ec); // set port reuse
 				//this->acceptor_->set_option(asio::ip::tcp::no_delay(true));
 				//this->acceptor_->non_blocking(true);
-
-				this->acceptor_.bind(endpoint);
-				this->acceptor_.listen();
-
-				asio::post(this->cio_.strand(), [this]() {
-					this->post_accept();
-				});
-				return true;
+				if (!ec)
+					this->acceptor_.bind(endpoint, ec);
+				if (!ec)
+					this->acceptor_.listen(asio::socket_base::max_listen_connections, ec);
 			}
-			catch (system_error & e) {
-				set_last_error(e);
+			if (ec) {
+				set_last_error(ec);
 				//this->acceptor_stop();
-				this->server_.stop(e.code());
+				this->server_.stop(ec);
+				return false;
 			}
-			return false;
+
+			asio::post(this->cio_.strand(), [this]() {
+				this->post_accept();
+			});
+			return true;
 		}
 
 		inline void post_accept() {
-			if (!this->server_.is_started())
+			if (!this->server_.is_running())
 				return;
-			try {
-				std::shared_ptr<SESSIONTYPE> session_ptr = this->server_.make_session();
-
-				auto & socket = session_ptr->socket().lowest_layer();
-				this->acceptor_.async_accept(socket, asio::bind_executor(this->cio_.strand(),
-					[this, session_ptr = std::move(session_ptr)](const error_code & ec)
-				{
-					set_last_error(ec);
-					if (ec == asio::error::operation_aborted) {
-						//this->acceptor_stop();
-						this->server_.stop(ec);
-						return;
-					}
-					if (!ec) {
-						if (this->server_.is_started()) {
-							session_ptr->start(ec);
-						}
-					}
-					this->post_accept();
-				}));
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-				// 处理打开文件太多导致的异常问题
-				this->acceptor_timer_.expires_after(std::chrono::seconds(1));
-				this->acceptor_timer_.async_wait(asio::bind_executor(this->cio_.strand(),
-					[this](const error_code & ec) {
-					set_last_error(ec);
-					if (ec) {
-						//this->acceptor_stop();
-						this->server_.stop(ec);
-						return;
+			std::shared_ptr<SESSIONTYPE> session_ptr = this->server_.make_session();
+
+			auto & socket = session_ptr->socket().lowest_layer();
+			this->acceptor_.async_accept(socket, asio::bind_executor(this->cio_.strand(),
+				[this, session_ptr = std::move(session_ptr)](const error_code & ec)
+			{
+				set_last_error(ec);
+				if (ec == asio::error::operation_aborted) {
+					//this->acceptor_stop();
+					this->server_.stop(ec);
+					return;
+				}
+				if (!ec) {
+					if (this->server_.is_running()) {
+						session_ptr->start(ec);
 					}
-					asio::post(this->cio_.strand(), [this]() {
-						this->post_accept();
-					});
-				}));
-			}
+				}
+				else if (ec == asio::error::no_descriptors) {
+					// 处理打开文件太多的问题, 稍后再接受连接
+					this->post_accept_delay();
+					return;
+				}
+				this->post_accept();
+			}));
+		}
+
+		inline void post_accept_delay() {
+			this->acceptor_timer_.expires_after(std::chrono::seconds(1));
+			this->acceptor_timer_.async_wait(asio::bind_executor(this->cio_.strand(),
+				[this](const error_code & ec) {
+				set_last_error(ec);
+				if (ec) {
+					//this->acceptor_stop();
+					this->server_.stop(ec);
+					return;
+				}
+				this->post_accept();
+			}));
 		}
 
 		inline void acceptor_stop() {
@@ -109,19 +114,17 @@ namespace net {
 		inline bool is_open() const { return this->acceptor_.is_open(); }
 
 		inline std::string listen_address() {
-			try {
-				return this->acceptor_.local_endpoint().address().to_string();
-			}
-			catch (system_error & e) { set_last_error(e); }
-			return std::string();
+			error_code ec;
+			auto endpoint = this->acceptor_.local_endpoint(ec);
+			set_last_error(ec);
+			return ec ? std::string() : endpoint.address().to_string();
 		}
 
 		inline unsigned short listen_port() {
-			try {
-				return this->acceptor_.local_endpoint().port();
-			}
-			catch (system_error & e) { set_last_error(e); }
-			return static_cast<unsigned short>(0);
+			error_code ec;
+			auto endpoint = this->acceptor_.local_endpoint(ec);
+			set_last_error(ec);
+			return ec ? static_cast<unsigned short>(0) : endpoint.port();
 		}
 
 	protected:
@@ -143,38 +146,40 @@ namespace net {
 		~Acceptor() = default;
 
 		inline bool acceptor_start(std::string_view host, std::string_view port) {
-			try {
-				clear_last_error();
-
-				this->acceptor_.close(ec_ignore);
+			clear_last_error();
 
-				asio::ip::udp::resolver resolver(this->cio_.context());
-				asio::ip::udp::endpoint endpoint = *resolver.resolve(host, port,
-					asio::ip::resolver_base::flags::passive | asio::ip::resolver_base::flags::address_configured).begin();
-
-				this->acceptor_.open(endpoint.protocol());
+			this->acceptor_.close(ec_ignore);
 
-				this->acceptor_.set_option(asio::ip::udp::socket::reuse_address(true)); // set port reuse
+			error_code ec;
+			asio::ip::udp::resolver resolver(this->cio_.context());
+			auto results = resolver.resolve(host, port,
+				asio::ip::resolver_base::flags::passive | asio::ip::resolver_base::flags::address_configured, ec);
+			if (!ec && results.empty())
+				ec = asio::error::host_not_found;
+			if (!ec) {
+				asio::ip::udp::endpoint endpoint = *results.begin();
+				this->acceptor_.open(endpoint.protocol(), ec);
+				if (!ec)
+					this->acceptor_.set_option(asio::ip::udp::socket::reuse_address(true), ec); // set port reuse
 
 				//this->acceptor_.set_option(
 				//	asio::ip::multicast::join_group(asio::ip::make_address("ff31::8000:1234")));
 				//	asio::ip::multicast::join_group(asio::ip::make_address("239.255.0.1")));
 
-
-				this->acceptor_.bind(endpoint);
-
-				asio::post(this->cio_.strand(), [this]() {
-					this->post_recv();
-				});
-
-				return true;
+				if (!ec)
+					this->acceptor_.bind(endpoint, ec);
 			}
-			catch (system_error& e) {
-				set_last_error(e);
-				this->server_.stop(e.code());
+			if (ec) {
+				set_last_error(ec);
+				this->server_.stop(ec);
+				return false;
 			}
 
-			return false;
+			asio::post(this->cio_.strand(), [this]() {
+				this->post_recv();
+			});
+
+			return true;
 		}
 
 		inline void acceptor_stop() {
@@ -183,21 +188,15 @@ namespace net {
 		}
 	protected:
 		inline void post_recv() {
-			if (!this->server_.is_started())
+			if (!this->server_.is_running())
 				return;
 
-			try {
-				this->buffer_.wr_reserve(init_buffer_size_);
-				this->acceptor_.async_receive_from(
-					asio::mutable_buffer(this->buffer_.wr_buf(), this->buffer_.wr_size()), this->remote_endpoint_,
-					asio::bind_executor(this->cio_.strand(), [this](const error_code& ec, std::size_t bytes_recvd) {
-					this->handle_recv(ec, bytes_recvd);
-				}));
-			}
-			catch (system_error& e) {
-				set_last_error(e);
-				this->server_.stop(e.code());
-			}
+			this->buffer_.wr_reserve(init_buffer_size_);
+			this->acceptor_.async_receive_from(
+				asio::mutable_buffer(this->buffer_.wr_buf(), this->buffer_.wr_size()), this->remote_endpoint_,
+				asio::bind_executor(this->cio_.strand(), [this](const error_code& ec, std::size_t bytes_recvd) {
+				this->handle_recv(ec, bytes_recvd);
+			}));
 		}
 
 		inline void handle_recv(const error_code& ec, std::size_t bytes_recvd) {
@@ -208,7 +207,7 @@ namespace net {
 				return;
 			}
 
-			if (!this->server_.is_started())
+			if (!this->server_.is_running())
 				return;
 
 			this->buffer_.rd_flip(bytes_recvd);
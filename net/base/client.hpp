@@ -7,16 +7,16 @@
 #include "base/csession.hpp"
 
 namespace net {
-	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void>
+	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void, class TRAITS = default_traits>
 	class Client : public IoPoolImp
 				 , public NetStream<SOCKETTYPE, STREAMTYPE>
-				 , public std::enable_shared_from_this<Client<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>> {
+				 , public std::enable_shared_from_this<Client<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>> {
 	public:
 		using resolver_type = typename asio::ip::basic_resolver<typename SOCKETTYPE::protocol_type>;
 		using endpoints_type = typename resolver_type::results_type;
 		using endpoint_type = typename SOCKETTYPE::lowest_layer_type::endpoint_type;
 		using endpoints_iterator = typename endpoints_type::iterator;
-		using session_type = CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>;
+		using session_type = CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>;
 		using session_ptr_type = std::shared_ptr<session_type>;
 		using session_weakptr_type = std::weak_ptr<session_type>;
 		using netstream_type = NetStream<SOCKETTYPE, STREAMTYPE>;
@@ -28,13 +28,15 @@ namespace net {
 			, cio_(iopool_.get(0))
 			, sessions_(cio_)
 			, max_buffer_size_(max_buffer_size)
-			, cbfunc_(std::make_shared<CBPROXYTYPE>())
+			, cbfunc_(std::make_shared<typename session_type::event_table_type>())
 		{
 			this->iopool_.start();
 		}
 
 		~Client() {
 			this->iopool_.stop();
+			if (this->workpool_)
+				this->workpool_->stop();
 		}
 
 		template<bool isAsync = true, bool isKeepAlive = false>
@@ -47,6 +49,19 @@ namespace net {
 			return session_ptr->template start<isAsync, isKeepAlive>(host, port);
 		}
 
+		// websocket: path为升级请求的路径
+		template<bool isAsync = true, bool isKeepAlive = false>
+		inline bool add(std::string_view host, std::string_view port, std::string_view path) {
+			static_assert(std::is_same_v<PROTOCOLTYPE, websocket_proto_flag>, "path is only used by websocket clients");
+			if (!is_started()) {
+				return false;
+			}
+			clear_last_error();
+			std::shared_ptr<session_type> session_ptr = this->make_session();
+			session_ptr->ws_path(path);
+			return session_ptr->template start<isAsync, isKeepAlive>(host, port);
+		}
+
 		inline bool start() {
 			State expected = State::stopped;
 			if (!this->state_.compare_exchange_strong(expected, State::starting)) {
@@ -95,6 +110,14 @@ namespace net {
 		}
 
 		inline session_ptr_type make_session() {
+			session_ptr_type session_ptr = this->create_session();
+			session_ptr->workpool(this->workpool_.get());
+			session_ptr->event_ring(this->ering_.get());
+			session_ptr->router(this->router_.get());
+			return session_ptr;
+		}
+
+		inline session_ptr_type create_session() {
 			auto& cio = this->iopool_.get();
 #if defined(NET_USE_SSL)
 			if constexpr (is_ssl_streamtype_v<STREAMTYPE>) {
@@ -123,11 +146,27 @@ namespace net {
 		bool bind(Args&&... args) {
 			return cbfunc_->bind(std::forward<Args>(args)...);
 		}
+		// 编译期检查回调签名: bind<Event::recv>(f)
+		template<Event E, class ...Args>
+		bool bind(Args&&... args) {
+			return cbfunc_->template bind<E>(std::forward<Args>(args)...);
+		}
 
 		template<class ...Args>
 		bool call(Args&&... args) {
 			return cbfunc_->call(std::forward<Args>(args)...);
 		}
+		template<Event E, class ...Args>
+		void call(Args&&... args) {
+			cbfunc_->template call<E>(std::forward<Args>(args)...);
+		}
+
+		// 消息路由, 需在start之前注册. 开启后收到的数据按(len, msg_id)分帧派发到注册的处理函数.
+		inline typename session_type::router_type& router() {
+			if (!this->router_)
+				this->router_ = std::make_unique<typename session_type::router_type>();
+			return *this->router_;
+		}
 
 		//广播所有session
 		inline void broadcast(const std::string_view && data) {
@@ -139,13 +178,17 @@ namespace net {
 		inline session_ptr_type find_session_if(const std::function<bool(session_ptr_type&)> & fn) {
 			return session_ptr_type(this->sessions_.find_if(fn));
 		}
+
+		auto& get_iopool() { return iopool_; }
 	protected:
 		NIO & cio_; 
 		SessionMgr<session_type> sessions_;
 
 		std::size_t max_buffer_size_;
 
-		FuncProxyImpPtr cbfunc_;
+		typename session_type::event_table_ptr_type cbfunc_;
+
+		std::unique_ptr<typename session_type::router_type> router_;
 
 		std::atomic<State> state_ = State::stopped;
 	};
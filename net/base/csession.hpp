@@ -4,6 +4,7 @@
 #include <future>
 #include <string_view>
 #include <string>
+#include <optional>
 
 #include "base/iopool.hpp"
 #include "base/error.hpp"
@@ -12,19 +13,30 @@
 #include "base/timer.hpp"
 #include "base/transfer_data.hpp"
 #include "base/proto.hpp"
+#include "base/event_table.hpp"
+#include "base/user_context.hpp"
+#include "base/session_stats.hpp"
+#include "base/session_event.hpp"
 #include "tool/bytebuffer.hpp"
 
 namespace net {
-	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void>
-	class CSession : public StreamType<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, SOCKETTYPE, STREAMTYPE, cli_tab>
-				   , public TransferData<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, cli_tab>
-				   , public NetProto<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, PROTOCOLTYPE, cli_tab>
-				   , public std::enable_shared_from_this<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>> {
+	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void, class TRAITS = default_traits>
+	class CSession : public StreamType<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, SOCKETTYPE, STREAMTYPE, cli_tab>
+				   , public TransferData<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, cli_tab, TRAITS>
+				   , public NetProto<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, PROTOCOLTYPE, cli_tab, TRAITS>
+				   , public UserContext<typename TRAITS::user_context_type>
+				   , public SessionStats<TRAITS::stats>
+				   , public SessionEvent<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>>
+				   , public std::enable_shared_from_this<CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>> {
 	public:
-		using session_type = CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>;
+		using session_type = CSession<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>;
 		using session_ptr_type = std::shared_ptr<session_type>;
+		using traits_type = TRAITS;
+		using buffer_type = traits_buffer_t<TRAITS>;
+		using event_table_type = event_table<session_ptr_type, typename TRAITS::event_policy>;
+		using event_table_ptr_type = std::shared_ptr<event_table_type>;
 		using stream_type = StreamType<session_type, SOCKETTYPE, STREAMTYPE, cli_tab>;
-		using transferdata_type = TransferData<session_type, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, cli_tab>;
+		using transferdata_type = TransferData<session_type, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, cli_tab, TRAITS>;
 		using resolver_type = typename asio::ip::basic_resolver<typename SOCKETTYPE::protocol_type>;
 		using endpoints_type = typename resolver_type::results_type;
 		using endpoint_type = typename SOCKETTYPE::lowest_layer_type::endpoint_type;
@@ -33,7 +45,7 @@ namespace net {
 		using key_type = std::size_t;
 	public:
 		template<class ...Args>
-		explicit CSession(SessionMgr<session_type>& sessions, FuncProxyImpPtr& cbfunc, NIO& io,
+		explicit CSession(SessionMgr<session_type>& sessions, event_table_ptr_type& cbfunc, NIO& io,
 						std::size_t max_buffer_size, Args&&... args)
 			: stream_type(std::forward<Args>(args)...)
 			, transferdata_type(max_buffer_size)
@@ -53,33 +65,36 @@ namespace net {
 				set_last_error(asio::error::already_started);
 				return false;
 			}
-			try {
-				clear_last_error();
+			clear_last_error();
 
-				return this->template connect<isAsync, isKeepAlive>(host, port);
-			}
-			catch (system_error& e) {
-				set_last_error(e);
-				this->stop(e.code());
-			}
-			return false;
+			return this->template connect<isAsync, isKeepAlive>(host, port);
 		}
 
 		inline void stop(const error_code& ec) {
 			auto handlefunc = [this](const error_code& ec, session_ptr_type sessionptr, State oldstate) {
-				asio::post(this->cio_.strand(), [this, ec, dptr = std::move(sessionptr), oldstate]() {
+				asio::post(this->io_executor(), [this, ec, dptr = std::move(sessionptr), oldstate]() {
 					set_last_error(ec);
+					this->proto_stop();
+					this->urgent_clear();
+					this->recv_paused_ = false;
 
-					this->user_data_reset();
 					this->stream_stop(dptr);
 					ctimer_.stop();
 					State expected = State::stopping;
 					if (this->state_.compare_exchange_strong(expected, State::stopped)) {
-						cbfunc_->call(Event::disconnect, dptr, ec);
+						this->post_event([this, dptr, ec]() mutable {
+							cbfunc_->template call<Event::disconnect>(dptr, ec);
+						});
 					}
 					else {
 						NET_ASSERT(false);
 					}
+					// 在disconnect之后重置, 工作线程上排队的回调仍能读到上下文;
+					// 路由缓存里上个连接没收完的半帧一起丢弃, 重连后从新帧开始
+					this->post_event([this, dptr]() {
+						this->user_data_reset();
+						this->rbuff_.reset();
+					});
 					//从sessionmgr移除
 					bool isremove = this->sessions_.erase(dptr);
 					if (!isremove) {
@@ -123,8 +138,15 @@ namespace net {
 		inline auto self_shared_ptr() { return this->shared_from_this(); }
 		//inline asio::streambuf& buffer() { return buffer_; }
 		inline NIO& cio() { return cio_; }
+		// session的io回调执行器, 由TRAITS::use_strand决定是否经过strand
+		inline decltype(auto) io_executor() {
+			if constexpr (TRAITS::use_strand)
+				return (this->cio_.strand());
+			else
+				return this->cio_.context().get_executor();
+		}
 		inline auto& cbfunc() { return cbfunc_; }
-		inline t_buffer_cmdqueue<>& rbuffer() { return rbuff_; }
+		inline buffer_type& rbuffer() { return rbuff_; }
 
 		inline bool is_started() const {
 			return (this->state_ == State::started && this->socket_.lowest_layer().is_open());
@@ -142,149 +164,156 @@ namespace net {
 				return this->stream().lowest_layer().local_endpoint();
 			}*/
 		}
-
-		template<class DataT>
-		inline void user_data(DataT&& data) {
-			this->user_data_ = std::forward<DataT>(data);
-		}
-		template<class DataT>
-		inline DataT* user_data() {
-			try {
-				return std::any_cast<DataT>(&this->user_data_);
-			}
-			catch (const std::bad_any_cast&) {}
-			return nullptr;
-		}
-		inline void user_data_reset() {
-			this->user_data_.reset();
-		}
 	protected:
 		// tcp connect
 		template<bool isAsync = true, bool isKeepAlive = false>
 		bool connect(const std::string_view& host, const std::string_view& port) {
-			try {
-				this->host_ = host;
-				this->port_ = port;
-
-				auto & socket = this->socket().lowest_layer();
-
-				socket.close(ec_ignore);
-				socket.open(this->endpoint().protocol());
-				socket.set_option(typename SOCKETTYPE::reuse_address(true));
+			this->host_ = host;
+			this->port_ = port;
+
+			auto & socket = this->socket().lowest_layer();
+
+			error_code ec;
+			socket.close(ec_ignore);
+			socket.open(this->endpoint().protocol(), ec);
+			if (!ec)
+				socket.set_option(typename SOCKETTYPE::reuse_address(true), ec);
+			if (ec) {
+				set_last_error(ec);
+				this->handle_connect(ec);
+				return false;
+			}
 
-				if constexpr (isKeepAlive && is_tcp_socket_v<SOCKETTYPE>)
-					this->keep_alive_options();
-				else
-					std::ignore = true;
+			if constexpr (isKeepAlive && is_tcp_socket_v<SOCKETTYPE>)
+				this->keep_alive_options();
+			else
+				std::ignore = true;
 
-				//初始化事件回调
-				cbfunc_->call(Event::init);
+			if (this->cio_.busy_poll().sock_usec > 0)
+				this->busy_poll(this->cio_.busy_poll().sock_usec);
 
-				socket.bind(this->endpoint());
+			//初始化事件回调
+			cbfunc_->template call<Event::init>();
 
-				auto dptr = this->shared_from_this();
+			socket.bind(this->endpoint(), ec);
+			if (ec) {
+				set_last_error(ec);
+				this->handle_connect(ec);
+				return false;
+			}
 
-				// 开始连接超时计时器
-				std::future<error_code> future = ctimer_.post_timeout_timer_test(std::chrono::seconds(5), [this, dptr](error_code ec) mutable {
-					if (!ec) {
-						ec = asio::error::timed_out;
-						this->handle_connect(ec);
-					}
-				});
+			auto dptr = this->shared_from_this();
 
-				std::unique_ptr<resolver_type> resolver_ptr = std::make_unique<resolver_type>(cio_.context());
-				//在async_resolve执行完成之前，我们必须保留resolver对象。
-				//因此，我们将resolver_ptr捕获到了lambda回调函数中。
-				resolver_type * resolver_pointer = resolver_ptr.get();
-				resolver_pointer->async_resolve(host, port, asio::bind_executor(cio_.strand(),
-					[this, dptr, resolver_ptr = std::move(resolver_ptr)]
-				(const error_code& ec, const endpoints_type& endpoints) {
-					set_last_error(ec);
-					this->endpoints_ = endpoints;
-					if (ec)
-						this->handle_connect(ec);
-					else
-						this->post_connect(ec, this->endpoints_.begin());
-				}));
-
-				if constexpr (isAsync)
-					return true;
-				else {
-					ctimer_.wait_timeout_timer(future);
-					return this->is_started();
+			// 开始连接超时计时器
+			std::future<error_code> future = ctimer_.post_timeout_timer_test(std::chrono::milliseconds(TRAITS::connect_timeout), [this, dptr](error_code ec) mutable {
+				if (!ec) {
+					ec = asio::error::timed_out;
+					this->handle_connect(ec);
 				}
+			});
+
+			std::unique_ptr<resolver_type> resolver_ptr = std::make_unique<resolver_type>(cio_.context());
+			//在async_resolve执行完成之前，我们必须保留resolver对象。
+			//因此，我们将resolver_ptr捕获到了lambda回调函数中。
+			resolver_type * resolver_pointer = resolver_ptr.get();
+			resolver_pointer->async_resolve(host, port, asio::bind_executor(this->io_executor(),
+				[this, dptr, resolver_ptr = std::move(resolver_ptr)]
+			(const error_code& ec, const endpoints_type& endpoints) {
+				set_last_error(ec);
+				this->endpoints_ = endpoints;
+				if (ec)
+					this->handle_connect(ec);
+				else
+					this->post_connect(ec, this->endpoints_.begin());
+			}));
+
+			if constexpr (isAsync)
+				return true;
+			else {
+				ctimer_.wait_timeout_timer(future);
+				return this->is_started();
 			}
-			catch (system_error & e) {
-				set_last_error(e);
-				this->handle_connect(e.code());
-			}
-			return false;
 		}
 
 		inline void post_connect(error_code ec, endpoints_iterator iter) {
-			try {
-				auto dptr = this->shared_from_this();
-				if (iter == this->endpoints_.end()) {
-					this->handle_connect(ec ? ec : asio::error::host_unreachable);
-					return;
-				}
-				// Start the asynchronous connect operation.
-				dptr->socket().lowest_layer().async_connect(iter->endpoint(),
-					asio::bind_executor(cio_.strand(),
-					[this, iter, dptr](const error_code & ec) mutable {
-					set_last_error(ec);
-					if (ec && ec != asio::error::operation_aborted)
-						this->post_connect(ec, ++iter);
-					else
-						this->handle_connect(ec);
-				}));
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-				this->handle_connect(ec);
+			auto dptr = this->shared_from_this();
+			if (iter == this->endpoints_.end()) {
+				this->handle_connect(ec ? ec : asio::error::host_unreachable);
+				return;
 			}
+			// Start the asynchronous connect operation.
+			dptr->socket().lowest_layer().async_connect(iter->endpoint(),
+				asio::bind_executor(this->io_executor(),
+				[this, iter, dptr](const error_code & ec) mutable {
+				set_last_error(ec);
+				if (ec && ec != asio::error::operation_aborted)
+					this->post_connect(ec, ++iter);
+				else
+					this->handle_connect(ec);
+			}));
 		}
 
 		inline void handle_connect(error_code ec) {
-			try {
-				ctimer_.stop();
-				asio::detail::throw_error(ec);
-
-				const auto& dptr = this->shared_from_this();
-				this->stream_post_handshake(dptr, [this, dptr = this->shared_from_this()](const error_code& ec) {
-					try {
-						//cbfunc_->call(Event::handshake, dptr, ec);
+			ctimer_.stop();
+			if (ec) {
+				set_last_error(ec);
+				this->stop(ec);
+				return;
+			}
 
-						State expected = State::starting;
-						if (!ec && !this->state_.compare_exchange_strong(expected, State::started))
-							asio::detail::throw_error(asio::error::operation_aborted);
+			const auto& dptr = this->shared_from_this();
+			this->stream_post_handshake(dptr, [this, dptr = this->shared_from_this()](const error_code& ec) {
+				//cbfunc_->call(Event::handshake, dptr, ec);
 
-						cbfunc_->call(Event::connect, dptr, ec);
+				State expected = State::starting;
+				if (!ec && !this->state_.compare_exchange_strong(expected, State::started)) {
+					set_last_error(asio::error::operation_aborted);
+					this->stop(asio::error::operation_aborted);
+					return;
+				}
 
-						asio::detail::throw_error(ec);
+				if (ec) {
+					this->handle_connected(ec);
+					return;
+				}
 
-						//加入到sessionmgr
-						bool isadd = this->sessions_.emplace(dptr);
-						if (isadd)
-							this->do_recv();
-						else
-							this->stop(asio::error::address_in_use);
-					}
-					catch (system_error& e) {
-						set_last_error(e);
-						this->stop(e.code());
-					}
+				// 协议握手(websocket升级)完成后才通知connect, 没有协议握手时立即完成
+				this->proto_handshake(this->host_, this->port_, [this](const error_code& ec) {
+					this->handle_connected(ec);
 				});
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-				this->stop(e.code());
+				if (this->proto_pending()) {
+					ctimer_.post_timer<false>(TRAITS::connect_timeout, [this, dptr](const error_code&) {
+						if (this->proto_pending()) {
+							set_last_error(asio::error::timed_out);
+							this->stop(asio::error::timed_out);
+						}
+					});
+				}
+
+				//加入到sessionmgr
+				bool isadd = this->sessions_.emplace(dptr);
+				if (isadd)
+					this->do_recv();
+				else
+					this->stop(asio::error::address_in_use);
+			});
+		}
+
+		inline void handle_connected(const error_code& ec) {
+			ctimer_.stop();
+			this->post_event([this, dptr = this->shared_from_this(), ec]() mutable {
+				cbfunc_->template call<Event::connect>(dptr, ec);
+			});
+
+			if (ec) {
+				set_last_error(ec);
+				this->stop(ec);
 			}
 		}
 	protected:
 		NIO & cio_;
 
-		FuncProxyImpPtr& cbfunc_;
+		event_table_ptr_type& cbfunc_;
 		SessionMgr<session_type>& sessions_;
 		Timer ctimer_;
 
@@ -294,8 +323,6 @@ namespace net {
 
 		std::atomic<State> state_ = State::stopped;
 
-		t_buffer_cmdqueue<> rbuff_;
-
-		std::any user_data_;
+		buffer_type rbuff_;
 	};
 }
\ No newline at end of file
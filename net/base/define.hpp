@@ -4,6 +4,8 @@
 
 #include "tool/help_type.hpp"
 #include "tool/util.hpp"
+#include "tool/bytebuffer.hpp"
+#include "tool/mirror_buffer.hpp"
 
 namespace net {
 	enum class State : std::int8_t { stopped, stopping, starting, started };
@@ -15,12 +17,91 @@ namespace net {
 		recv,
 		packet,
 		handshake,
+		recv_begin,		// 流式接收的消息开始, 参数为总长度(未知时为0)
+		recv_chunk,		// 流式接收的一段数据
+		recv_end,		// 流式接收的消息结束
 		max
 	};
 
 	using CBPROXYTYPE = func_proxy_imp<Event>;
 	typedef std::shared_ptr<CBPROXYTYPE> FuncProxyImpPtr;
 
+	// server/client的编译期配置, 自定义时继承default_traits并覆盖需要的项.
+	struct default_traits {
+		// 以静态成员函数处理事件的策略类, 见base/event_table.hpp
+		using event_policy = void;
+		// session上的用户数据类型, void时使用std::any, 见base/user_context.hpp
+		using user_context_type = void;
+
+		// 接收缓存块大小(字节)
+		static constexpr unsigned int buffer_size = trunkSize;
+		// true: 接收缓存为定长数组, 不扩容, 帧超过buffer_size时断开连接; false: 按需扩容
+		static constexpr bool static_buffer = false;
+		// true: 接收缓存(tcp分帧, websocket解析, kcp)使用镜像环形缓冲区, 不整理不重新分配, 优先于static_buffer
+		static constexpr bool use_mirror_buffer = false;
+		// udp/kcp单次读取预留的缓存大小
+		static constexpr unsigned int udp_buffer_size = 1024;
+		// 不小于该长度的消息(websocket, kcp)按recv_begin/recv_chunk/recv_end流式派发, 不在内存里凑齐整条消息; 0关闭
+		static constexpr std::size_t stream_recv_size = 0;
+		// 每个session发送队列的最大长度, 0不限制; 超过时send返回false(no_buffer_space)
+		static constexpr std::size_t send_queue_size = 0;
+		// 客户端连接超时(毫秒)
+		static constexpr std::int64_t connect_timeout = 5000;
+		// websocket单条消息(包括分片合并后)的最大长度, 超过时断开连接
+		static constexpr std::size_t ws_max_message_size = 16 * 1024 * 1024;
+		// websocket分片发送(send_stream/send_file)每片负载的大小
+		static constexpr std::size_t ws_fragment_size = 64 * 1024;
+		// websocket文本消息(和关闭原因)按RFC 6455校验UTF-8, 非法时断开连接; 可信的内部连接可以关闭
+		static constexpr bool ws_validate_utf8 = true;
+		// websocket心跳(毫秒): 连接空闲ws_ping_interval后发送ping, 之后ws_ping_timeout内没有收到任何数据则断开; 0不发送
+		static constexpr std::int64_t ws_ping_interval = 0;
+		static constexpr std::int64_t ws_ping_timeout = 10000;
+
+		// kcp参数, 见ikcp_nodelay/ikcp_wndsize
+		struct kcp {
+			static constexpr int nodelay = 1;
+			static constexpr int interval = 10;
+			static constexpr int resend = 2;
+			static constexpr int nc = 1;
+			static constexpr int sndwnd = 128;
+			static constexpr int rcvwnd = 512;
+		};
+
+		// websocket permessage-deflate(RFC 7692), 需要定义NET_USE_ZLIB; 客户端握手时声明支持才启用
+		struct ws_deflate {
+			static constexpr bool enable = false;
+			static constexpr int level = 1;
+			static constexpr int mem_level = 8;
+			static constexpr int server_max_window_bits = 15;
+			static constexpr int client_max_window_bits = 15;
+			static constexpr bool server_no_context_takeover = false;
+			static constexpr bool client_no_context_takeover = false;
+			// 小于该长度的消息不压缩
+			static constexpr std::size_t min_size = 256;
+		};
+
+		// session的io回调经过strand; 每个io_context只由一个线程运行时可以关闭
+		static constexpr bool use_strand = true;
+		// 统计收发字节数和包数, 见base/session_stats.hpp
+		static constexpr bool stats = false;
+	};
+
+	// 按traits选择接收缓存类型
+	template<class TRAITS>
+	using traits_buffer_t = std::conditional_t<TRAITS::use_mirror_buffer, t_mirror_cmdqueue<TRAITS::buffer_size>,
+		std::conditional_t<TRAITS::static_buffer, t_static_cmdqueue<TRAITS::buffer_size>, t_buffer_cmdqueue<TRAITS::buffer_size>>>;
+	// 需要按帧长扩容的接收缓存(websocket, kcp)
+	template<class TRAITS>
+	using traits_stream_buffer_t = std::conditional_t<TRAITS::use_mirror_buffer,
+		t_mirror_cmdqueue<TRAITS::buffer_size>, t_buffer_cmdqueue<TRAITS::buffer_size>>;
+
+	// 协议头(websocket帧头最长14字节), 发送时和负载一起聚合写出, 负载不再拷贝
+	struct proto_head {
+		std::uint8_t size = 0;
+		char data[14];
+		std::string body;	// 非空时代替原始负载发送(如压缩后的消息)
+	};
+
 	struct tcp_transfer_place {
 	};
 	struct udp_transfer_place {
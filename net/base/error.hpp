@@ -10,6 +10,10 @@
 #include <cassert>
 #include <string>
 #include <system_error>
+#if defined(ASIO_NO_EXCEPTIONS)
+#include <cstdio>
+#include <cstdlib>
+#endif
 
 namespace net {
 
@@ -67,3 +71,17 @@ namespace net {
 	//error_code的线程局部变量，仅用于占位符。
 	thread_local static error_code ec_ignore;
 }
+
+#if defined(ASIO_NO_EXCEPTIONS)
+// 关闭异常(NET_NO_EXCEPTIONS)时由应用提供asio的throw_exception.
+// 网络层只使用error_code重载, 走到这里的都是无法恢复的错误(如内存不足), 打印后直接终止.
+namespace asio {
+	namespace detail {
+		template<typename Exception>
+		void throw_exception(const Exception& e) {
+			std::fprintf(stderr, "asio fatal error: %s\n", e.what());
+			std::abort();
+		}
+	}
+}
+#endif
@@ -0,0 +1,276 @@
+#pragma once
+
+/*
+* 回调事件表：按Event下标存放每个事件的回调, 签名在编译期检查.
+* 可选策略类(TRAITS::event_policy)：以静态成员函数处理事件, 编译器可以直接内联, 不经过std::function.
+*	struct my_policy {
+*		template<class SESSIONPTR> static void on_recv(SESSIONPTR& ptr, std::string&& s) { ... }
+*	};
+*	struct my_traits : net::default_traits { using event_policy = my_policy; };
+*	net::Server<asio::ip::tcp::socket, net::binary_stream_flag, void, my_traits> svr;
+*/
+
+#include <tuple>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#include "base/define.hpp"
+#include "base/error.hpp"
+
+namespace net {
+	// 各事件的回调签名
+	template<Event E, class SESSIONPTR>
+	struct event_signature;
+	template<class SESSIONPTR>
+	struct event_signature<Event::init, SESSIONPTR> { using type = void(); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::connect, SESSIONPTR> { using type = void(SESSIONPTR&, error_code); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::disconnect, SESSIONPTR> { using type = void(SESSIONPTR&, error_code); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::recv, SESSIONPTR> { using type = void(SESSIONPTR&, std::string&&); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::packet, SESSIONPTR> { using type = void(SESSIONPTR&, std::string&&); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::handshake, SESSIONPTR> { using type = void(SESSIONPTR&, error_code); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::recv_begin, SESSIONPTR> { using type = void(SESSIONPTR&, std::uint64_t); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::recv_chunk, SESSIONPTR> { using type = void(SESSIONPTR&, std::string_view); };
+	template<class SESSIONPTR>
+	struct event_signature<Event::recv_end, SESSIONPTR> { using type = void(SESSIONPTR&); };
+
+	template<Event E, class SESSIONPTR>
+	using event_signature_t = typename event_signature<E, SESSIONPTR>::type;
+
+	// 策略类中各事件对应的静态成员函数
+	template<Event E>
+	struct policy_handler;
+	template<>
+	struct policy_handler<Event::init> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_init(std::forward<Args>(args)...)) {
+			return POLICY::on_init(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::connect> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_connect(std::forward<Args>(args)...)) {
+			return POLICY::on_connect(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::disconnect> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_disconnect(std::forward<Args>(args)...)) {
+			return POLICY::on_disconnect(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::recv> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_recv(std::forward<Args>(args)...)) {
+			return POLICY::on_recv(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::packet> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_packet(std::forward<Args>(args)...)) {
+			return POLICY::on_packet(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::handshake> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_handshake(std::forward<Args>(args)...)) {
+			return POLICY::on_handshake(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::recv_begin> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_recv_begin(std::forward<Args>(args)...)) {
+			return POLICY::on_recv_begin(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::recv_chunk> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_recv_chunk(std::forward<Args>(args)...)) {
+			return POLICY::on_recv_chunk(std::forward<Args>(args)...);
+		}
+	};
+	template<>
+	struct policy_handler<Event::recv_end> {
+		template<class POLICY, class... Args>
+		static auto call(Args&&... args) -> decltype(POLICY::on_recv_end(std::forward<Args>(args)...)) {
+			return POLICY::on_recv_end(std::forward<Args>(args)...);
+		}
+	};
+
+	template<Event E, class POLICY, class SIGNATURE, class = void>
+	struct has_policy_handler : std::false_type {};
+	template<Event E, class POLICY, class... Args>
+	struct has_policy_handler<E, POLICY, void(Args...),
+		std::void_t<decltype(policy_handler<E>::template call<POLICY>(std::declval<Args>()...))>> : std::true_type {};
+
+	template<class SESSIONPTR, class POLICY = void>
+	class event_table {
+	public:
+		using session_ptr_type = SESSIONPTR;
+		template<Event E>
+		using function_type = std::function<event_signature_t<E, SESSIONPTR>>;
+		template<Event E>
+		static constexpr bool has_policy_v = has_policy_handler<E, POLICY, event_signature_t<E, SESSIONPTR>>::value;
+		static constexpr std::size_t size = static_cast<std::size_t>(Event::max);
+
+	public:
+		event_table() = default;
+		~event_table() = default;
+
+		// 编译期绑定, 签名不匹配编译报错.
+		template<Event E, class F>
+		inline bool bind(F&& f) {
+			static_assert(E < Event::max, "invalid event");
+			static_assert(bindable<E, std::decay_t<F>&>(), "callback signature does not match the event");
+			if constexpr (has_policy_v<E>) {
+				// 已由策略类处理
+				set_last_error(asio::error::already_open);
+				return false;
+			}
+			else {
+				auto& fn = std::get<index(E)>(this->fns_);
+				if (fn) {
+					set_last_error(asio::error::already_open);
+					return false;
+				}
+				fn = function_type<E>(std::forward<F>(f));
+				return true;
+			}
+		}
+		// 成员函数 + 对象(引用, 指针或者shared_ptr)
+		template<Event E, class F, class C, typename = std::enable_if_t<std::is_member_function_pointer_v<std::decay_t<F>>>>
+		inline bool bind(F&& f, C&& c) {
+			static_assert(bindable<E, std::decay_t<F>, typename bind_object<C>::type&>(), "callback signature does not match the event");
+			if constexpr (std::is_pointer_v<std::decay_t<C>> || is_shared_ptr_v<std::decay_t<C>>) {
+				if (!c)
+					return false;
+				return this->bind<E>([fn = std::forward<F>(f), s = std::forward<C>(c)](auto&&... args) mutable {
+					((*s).*fn)(std::forward<decltype(args)>(args)...);
+				});
+			}
+			else {
+				return this->bind<E>([fn = std::forward<F>(f), s = std::forward<C>(c)](auto&&... args) mutable {
+					(s.*fn)(std::forward<decltype(args)>(args)...);
+				});
+			}
+		}
+
+		// 运行期绑定(兼容bind(Event::xxx, ...)), 签名不匹配返回false.
+		template<class... Args>
+		inline bool bind(Event evt, Args&&... args) {
+			return this->bind_dispatch(evt, std::make_index_sequence<size>{}, std::forward<Args>(args)...);
+		}
+
+		template<Event E, class... Args>
+		inline void call(Args&&... args) {
+			static_assert(std::is_invocable_v<function_type<E>&, Args&&...>, "arguments do not match the event");
+			if constexpr (has_policy_v<E>) {
+				policy_handler<E>::template call<POLICY>(std::forward<Args>(args)...);
+			}
+			else {
+				auto& fn = std::get<index(E)>(this->fns_);
+				if (fn)
+					fn(std::forward<Args>(args)...);
+			}
+		}
+
+		// 运行期调用(兼容call(Event::xxx, ...)), 未绑定或者参数不匹配返回false.
+		template<class... Args>
+		inline bool call(Event evt, Args&&... args) {
+			return this->call_dispatch(evt, std::make_index_sequence<size>{}, std::forward<Args>(args)...);
+		}
+
+		template<Event E>
+		inline bool check() const {
+			if constexpr (has_policy_v<E>)
+				return true;
+			else
+				return static_cast<bool>(std::get<index(E)>(this->fns_));
+		}
+
+	protected:
+		static constexpr std::size_t index(Event e) { return static_cast<std::size_t>(e); }
+
+		template<class C, bool = std::is_pointer_v<std::decay_t<C>> || is_shared_ptr_v<std::decay_t<C>>>
+		struct bind_object { using type = std::decay_t<C>; };
+		template<class C>
+		struct bind_object<C, true> { using type = std::remove_reference_t<decltype(*std::declval<std::decay_t<C>&>())>; };
+
+		template<class SIGNATURE>
+		struct signature_args;
+		template<class... Args>
+		struct signature_args<void(Args...)> {
+			template<class F, class... Pre>
+			static constexpr bool invocable = std::is_invocable_v<F, Pre..., Args...>;
+		};
+
+		// F(Pre..., 事件参数...)是否可调用
+		template<Event E, class F, class... Pre>
+		static constexpr bool bindable() {
+			return signature_args<event_signature_t<E, SESSIONPTR>>::template invocable<F, Pre...>;
+		}
+
+		template<std::size_t... I, class... Args>
+		inline bool bind_dispatch(Event evt, std::index_sequence<I...>, Args&&... args) {
+			bool ret = false;
+			((index(evt) == I ? (ret = this->bind_at<static_cast<Event>(I)>(std::forward<Args>(args)...), true) : false) || ...);
+			return ret;
+		}
+		template<Event E, class F>
+		inline bool bind_at(F&& f) {
+			if constexpr (bindable<E, std::decay_t<F>&>())
+				return this->bind<E>(std::forward<F>(f));
+			set_last_error(asio::error::invalid_argument);
+			return false;
+		}
+		template<Event E, class F, class C>
+		inline bool bind_at(F&& f, C&& c) {
+			if constexpr (std::is_member_function_pointer_v<std::decay_t<F>>) {
+				if constexpr (bindable<E, std::decay_t<F>, typename bind_object<C>::type&>())
+					return this->bind<E>(std::forward<F>(f), std::forward<C>(c));
+			}
+			set_last_error(asio::error::invalid_argument);
+			return false;
+		}
+
+		template<std::size_t... I, class... Args>
+		inline bool call_dispatch(Event evt, std::index_sequence<I...>, Args&&... args) {
+			bool ret = false;
+			((index(evt) == I ? (ret = this->call_at<static_cast<Event>(I)>(std::forward<Args>(args)...), true) : false) || ...);
+			return ret;
+		}
+		template<Event E, class... Args>
+		inline bool call_at(Args&&... args) {
+			if constexpr (std::is_invocable_v<function_type<E>&, Args&&...>) {
+				if (!this->check<E>())
+					return false;
+				this->call<E>(std::forward<Args>(args)...);
+				return true;
+			}
+			else
+				return false;
+		}
+
+		template<std::size_t... I>
+		static auto make_functions(std::index_sequence<I...>) -> std::tuple<function_type<static_cast<Event>(I)>...>;
+
+		decltype(make_functions(std::make_index_sequence<size>{})) fns_;
+	};
+}
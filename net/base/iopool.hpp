@@ -1,25 +1,66 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
 #include <thread>
 #include <mutex>
 #include <chrono>
+#include <cstdint>
 #include <type_traits>
 
 #include "base/define.hpp"
+#include "base/timer_wheel.hpp"
+#include "tool/mpsc_ring.hpp"
 
 namespace net {
+	// 忙轮询策略: spin为0时阻塞在run()上(默认);
+	// 否则连续spin次poll不到事件后, park为true则阻塞在run_one()上等待下一个事件, 为false则一直自旋.
+	// sock_usec>0时, 该线程上的socket会设置SO_BUSY_POLL/SO_PREFER_BUSY_POLL(linux).
+	struct BusyPoll {
+		std::size_t spin = 0;
+		bool park = true;
+		int sock_usec = 0;
+	};
+
 	class NIO {
 	public:
-		NIO() : context_(1), strand_(context_) {}
+		NIO() : context_(1), strand_(context_), wheel_(context_) {}
 		~NIO() = default;
 
 		inline asio::io_context & context() { return this->context_; }
 		inline asio::io_context::strand &  strand() { return this->strand_; }
+		inline const BusyPoll & busy_poll() const { return this->busy_poll_; }
+		inline void busy_poll(const BusyPoll & policy) { this->busy_poll_ = policy; }
+		// 该io线程上共用的时间轮(websocket心跳等), 只能在该io线程上使用
+		inline TimerWheel & wheel() { return this->wheel_; }
+
+		inline void run() {
+			if (this->busy_poll_.spin == 0) {
+				this->context_.run();
+				return;
+			}
+			std::size_t idle = 0;
+			while (!this->context_.stopped()) {
+				if (this->context_.poll() > 0) {
+					idle = 0;
+					continue;
+				}
+				if (++idle < this->busy_poll_.spin || !this->busy_poll_.park)
+					continue;
+				idle = 0;
+				this->context_.run_one();
+			}
+		}
 
 	protected:
 		asio::io_context context_;
 		asio::io_context::strand strand_;
+		TimerWheel wheel_;
+		BusyPoll busy_poll_;
 	};
 
 	class IoPool {
@@ -45,9 +86,12 @@ namespace net {
 
 			for (auto & io : this->ios_) {
 				this->works_.emplace_back(io.context().get_executor());
+				// 外部驱动模式不创建io线程, 由应用主循环调用poll
+				if (this->external_)
+					continue;
 				// start work thread
 				this->threads_.emplace_back([&io]() {
-					io.context().run();
+					io.run();
 				});
 			}
 
@@ -97,6 +141,76 @@ namespace net {
 		inline NIO & get(std::size_t index = static_cast<std::size_t>(-1)) {
 			return this->ios_[index < this->ios_.size() ? index : ((++(this->next_)) % this->ios_.size())];
 		}
+
+		inline std::size_t size() const { return this->ios_.size(); }
+
+		// 指定的io线程切换为忙轮询模式, 已经运行的iopool会重启io线程使其生效.
+		// 建议在server/client的start之前调用.
+		bool busy_poll(const std::vector<std::size_t> & indexes, const BusyPoll & policy) {
+			if (this->running_in_iopool_threads())
+				return false;
+			for (std::size_t index : indexes) {
+				if (index >= this->ios_.size())
+					return false;
+			}
+			bool running = !this->stopped_;
+			if (running)
+				this->stop();
+			for (std::size_t index : indexes) {
+				this->ios_[index].busy_poll(policy);
+			}
+			if (running)
+				return this->start();
+			return true;
+		}
+
+		// 切换为外部驱动模式: 不创建io线程, 所有io事件和回调都在调用poll的线程中执行.
+		// 已经运行的iopool会先停止io线程. 建议在server/client的start之前调用.
+		bool external(bool enable = true) {
+			if (this->running_in_iopool_threads())
+				return false;
+			bool running = !this->stopped_;
+			if (running)
+				this->stop();
+			this->external_ = enable;
+			if (running)
+				return this->start();
+			return true;
+		}
+		inline bool is_external() const { return this->external_; }
+
+		// 外部驱动模式下由应用主循环调用: 轮流在各io_context上poll_one, 
+		// 直到没有就绪的事件, 或处理了max_events个事件, 或用完budget(为0时不限时). 返回处理的事件数.
+		std::size_t poll(std::size_t max_events = static_cast<std::size_t>(-1),
+			std::chrono::microseconds budget = std::chrono::microseconds::zero()) {
+			std::size_t count = 0;
+			auto deadline = std::chrono::steady_clock::now() + budget;
+			while (count < max_events) {
+				std::size_t handled = 0;
+				for (auto & io : this->ios_) {
+					if (io.context().poll_one() > 0)
+						++handled;
+					if (count + handled >= max_events)
+						break;
+				}
+				count += handled;
+				if (handled == 0)
+					break;
+				if (budget.count() > 0 && std::chrono::steady_clock::now() >= deadline)
+					break;
+			}
+			return count;
+		}
+
+		// 当前线程在iopool中的索引, 不是io线程返回-1.
+		inline std::size_t current_index() {
+			std::thread::id curr_tid = std::this_thread::get_id();
+			for (std::size_t i = 0; i < this->threads_.size(); ++i) {
+				if (curr_tid == this->threads_[i].get_id())
+					return i;
+			}
+			return static_cast<std::size_t>(-1);
+		}
 		
 		inline bool running_in_iopool_threads() {
 			std::thread::id curr_tid = std::this_thread::get_id();
@@ -153,16 +267,414 @@ namespace net {
 		std::vector<asio::executor_work_guard<asio::io_context::executor_type>> works_;
 		std::mutex  mutex_;
 		bool stopped_ = true;
+		bool external_ = false;
 		std::size_t next_ = 0;
 	};
 
+	// 工作线程池：把耗时的事件回调(db查询,重度解码等)从io线程中剥离出来.
+	// 所有工作线程共享一个io_context, 每个session持有一个strand, 保证同一session的事件按序执行,
+	// 不同session的事件由空闲的工作线程争抢执行.
+	class WorkPool {
+	public:
+		using strand_type = asio::strand<asio::io_context::executor_type>;
+	public:
+		explicit WorkPool(std::size_t concurrency = std::thread::hardware_concurrency())
+			: context_(static_cast<int>(concurrency == 0 ? std::thread::hardware_concurrency() : concurrency))
+			, work_(context_.get_executor()) {
+			std::size_t count = (concurrency == 0 ? std::thread::hardware_concurrency() : concurrency);
+			this->threads_.reserve(count);
+			for (std::size_t i = 0; i < count; ++i) {
+				this->threads_.emplace_back([this]() {
+					this->context_.run();
+				});
+			}
+		}
+
+		~WorkPool() {
+			this->stop();
+		}
+
+		// 等待已投递的事件执行完毕后退出.
+		void stop() {
+			std::lock_guard<std::mutex> guard(this->mutex_);
+			if (this->threads_.empty() || this->running_in_workpool_threads())
+				return;
+
+			this->work_.reset();
+			for (auto & thread : this->threads_) {
+				thread.join();
+			}
+			this->threads_.clear();
+		}
+
+		inline asio::io_context & context() { return this->context_; }
+		inline strand_type make_strand() { return strand_type(this->context_.get_executor()); }
+		inline std::size_t size() const { return this->threads_.size(); }
+
+		inline bool running_in_workpool_threads() {
+			std::thread::id curr_tid = std::this_thread::get_id();
+			for (auto & thread : this->threads_) {
+				if (curr_tid == thread.get_id())
+					return true;
+			}
+			return false;
+		}
+
+	protected:
+		asio::io_context context_;
+		asio::executor_work_guard<asio::io_context::executor_type> work_;
+		std::vector<std::thread> threads_;
+		std::mutex mutex_;
+	};
+
+	// 任务调度器：为没有session亲和性的任务(扇出计算,批量编码等)提供负载均衡.
+	// 每个io线程一个任务队列, 任务优先由所属线程从队尾取出执行; 每个队列同时最多有一个唤醒在io_context里排队.
+	// 所属线程积压超过steal_threshold且跟不上(正在执行任务, 或者唤醒还在排队)时, 唤醒一个空闲io线程从队首窃取.
+	// io线程是否空闲看任务队列和唤醒的排队时延: 忙于网络事件的线程唤醒会排队, 一段时间内不参与窃取.
+	class TaskScheduler {
+	public:
+		using task_type = std::function<void()>;
+		static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+	public:
+		explicit TaskScheduler(IoPool& iopool) : iopool_(iopool), queues_(iopool.size()) {}
+		~TaskScheduler() = default;
+
+		// 积压多少个任务之后才唤醒其他线程窃取
+		inline void steal_threshold(std::size_t count) { this->steal_threshold_ = count; }
+		// 唤醒的排队时延超过该值时, 认为该io线程忙于网络事件
+		inline void congest_lag(std::chrono::microseconds lag) { this->congest_lag_ = lag; }
+
+		// 投递任务, 在io线程中调用时优先投递到当前线程.
+		inline void post(task_type task) {
+			std::size_t index = this->iopool_.current_index();
+			if (index >= this->queues_.size())
+				index = (this->next_++) % this->queues_.size();
+
+			task_queue& queue = this->queues_[index];
+			std::size_t pending = 0;
+			{
+				std::lock_guard<std::mutex> guard(queue.mutex);
+				queue.tasks.emplace_back(std::move(task));
+				pending = queue.tasks.size();
+				queue.depth.store(pending, std::memory_order_relaxed);
+			}
+			this->notify(index);
+
+			if (pending > this->steal_threshold_ && this->lagging(index)) {
+				std::size_t thief = this->find_idle(index);
+				if (thief != npos)
+					this->notify(thief);
+			}
+		}
+
+		// 投递到session所在的io线程执行, 不参与窃取.
+		template<class SESSIONPTR>
+		inline void post_to(SESSIONPTR& session, task_type task) {
+			asio::post(session->cio().strand(), std::move(task));
+		}
+
+		// 把[begin, end)分块投递执行, 阻塞到全部完成; 等待期间调用线程也参与执行任务.
+		template<class Fn>
+		inline void parallel_for(std::size_t begin, std::size_t end, Fn&& fn, std::size_t grain = 0) {
+			if (begin >= end)
+				return;
+			std::size_t count = end - begin;
+			if (grain == 0)
+				grain = (std::max<std::size_t>)(1, count / (this->queues_.size() * 4));
+
+			struct for_state {
+				std::atomic<std::size_t> remaining{ 0 };
+				std::mutex mutex;
+				std::condition_variable cv;
+			};
+			auto state = std::make_shared<for_state>();
+			state->remaining = (count + grain - 1) / grain;
+
+			for (std::size_t first = begin; first < end; first += grain) {
+				std::size_t last = (std::min)(end, first + grain);
+				this->post([state, first, last, &fn]() {
+					for (std::size_t i = first; i < last; ++i) {
+						fn(i);
+					}
+					if (--state->remaining == 0) {
+						std::lock_guard<std::mutex> guard(state->mutex);
+						state->cv.notify_all();
+					}
+				});
+			}
+
+			std::size_t index = this->iopool_.current_index();
+			while (state->remaining > 0) {
+				if (this->run_one(index))
+					continue;
+				std::unique_lock<std::mutex> guard(state->mutex);
+				state->cv.wait_for(guard, std::chrono::milliseconds(1), [&state]() { return state->remaining == 0; });
+			}
+		}
+
+		// 执行一个任务: 先取自己队列, 再从其他队列窃取. index为npos时只窃取.
+		inline bool run_one(std::size_t index) {
+			task_type task;
+			if (!(index < this->queues_.size() && this->pop(index, task)) && !this->steal(index, task))
+				return false;
+
+			if (index < this->queues_.size()) {
+				this->queues_[index].busy.store(true, std::memory_order_relaxed);
+				task();
+				this->queues_[index].busy.store(false, std::memory_order_relaxed);
+			}
+			else
+				task();
+			return true;
+		}
+
+	protected:
+		struct task_queue {
+			std::mutex mutex;
+			std::deque<task_type> tasks;
+			std::atomic<std::size_t> depth{ 0 };
+			std::atomic<bool> busy{ false };			// 正在执行任务
+			std::atomic<bool> scheduled{ false };		// 唤醒在io_context里排队
+			std::atomic<std::int64_t> scheduled_at{ 0 };
+			std::atomic<std::int64_t> congested_until{ 0 };
+		};
+
+		static inline std::int64_t now_us() {
+			return std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// 已经有唤醒在排队时不再投递; 唤醒每次只执行一个任务, 还有任务时重新排到队尾, 不饿死网络事件
+		inline void notify(std::size_t index) {
+			task_queue& queue = this->queues_[index];
+			if (queue.scheduled.exchange(true, std::memory_order_acq_rel))
+				return;
+			queue.scheduled_at.store(now_us(), std::memory_order_relaxed);
+			asio::post(this->iopool_.get(index).context(), [this, index]() {
+				this->drain(index);
+			});
+		}
+
+		inline void drain(std::size_t index) {
+			task_queue& queue = this->queues_[index];
+			std::int64_t now = now_us();
+			if (now - queue.scheduled_at.load(std::memory_order_relaxed) > this->congest_lag_.count())
+				queue.congested_until.store(now + congest_hold_us, std::memory_order_relaxed);
+			queue.scheduled.store(false, std::memory_order_release);
+
+			bool stole = queue.depth.load(std::memory_order_relaxed) == 0;
+			if (!this->run_one(index))
+				return;
+			if (queue.depth.load(std::memory_order_relaxed) > 0 || (stole && this->find_loaded(index) != npos))
+				this->notify(index);
+		}
+
+		// 所属线程跟不上自己的队列
+		inline bool lagging(std::size_t index) {
+			task_queue& queue = this->queues_[index];
+			return queue.busy.load(std::memory_order_relaxed) || queue.scheduled.load(std::memory_order_relaxed);
+		}
+
+		inline bool pop(std::size_t index, task_type& task) {
+			task_queue& queue = this->queues_[index];
+			std::lock_guard<std::mutex> guard(queue.mutex);
+			if (queue.tasks.empty())
+				return false;
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			queue.depth.store(queue.tasks.size(), std::memory_order_relaxed);
+			return true;
+		}
+
+		inline bool steal(std::size_t index, task_type& task) {
+			std::size_t size = this->queues_.size();
+			std::size_t start = (index < size ? index + 1 : 0);
+			for (std::size_t i = 0; i < size; ++i) {
+				std::size_t victim = (start + i) % size;
+				if (victim == index)
+					continue;
+				task_queue& queue = this->queues_[victim];
+				if (queue.depth.load(std::memory_order_relaxed) == 0)
+					continue;
+				std::unique_lock<std::mutex> guard(queue.mutex, std::try_to_lock);
+				if (!guard.owns_lock() || queue.tasks.empty())
+					continue;
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				queue.depth.store(queue.tasks.size(), std::memory_order_relaxed);
+				return true;
+			}
+			return false;
+		}
+
+		// 没有任务, 没有排队的唤醒, 最近也没有表现出网络事件繁忙
+		inline std::size_t find_idle(std::size_t index) {
+			std::size_t size = this->queues_.size();
+			std::int64_t now = now_us();
+			for (std::size_t i = 1; i < size; ++i) {
+				std::size_t other = (index + i) % size;
+				task_queue& queue = this->queues_[other];
+				if (queue.depth.load(std::memory_order_relaxed) == 0 && !this->lagging(other)
+					&& queue.congested_until.load(std::memory_order_relaxed) <= now)
+					return other;
+			}
+			return npos;
+		}
+
+		// 积压超过阈值且所属线程跟不上的队列
+		inline std::size_t find_loaded(std::size_t index) {
+			std::size_t size = this->queues_.size();
+			for (std::size_t i = 1; i < size; ++i) {
+				std::size_t other = (index + i) % size;
+				if (this->queues_[other].depth.load(std::memory_order_relaxed) > this->steal_threshold_ && this->lagging(other))
+					return other;
+			}
+			return npos;
+		}
+
+	protected:
+		static constexpr std::int64_t congest_hold_us = 100 * 1000;
+
+		IoPool& iopool_;
+		std::vector<task_queue> queues_;
+		std::atomic<std::size_t> next_{ 0 };
+		std::size_t steal_threshold_ = 4;
+		std::chrono::microseconds congest_lag_{ 1000 };
+	};
+
+	// 事件环：io线程把回调事件压入无锁环形队列, 由应用主循环批量取出执行.
+	// 满时压入失败的session登记一次唤醒, drain腾出空间后由主循环调用, 投递回session的io线程重试.
+	class EventRing : public mpsc_ring<std::function<void()>> {
+	public:
+		using mpsc_ring::mpsc_ring;
+
+		// 只在事件环满时调用, 加锁的开销可以接受
+		inline void wait(std::function<void()>&& fn) {
+			std::lock_guard<std::mutex> lock(this->mutex_);
+			this->waiters_.emplace_back(std::move(fn));
+			this->waiting_.store(true, std::memory_order_release);
+		}
+		// 在消费者线程调用; 没有等待者时只有一次原子读
+		inline void notify() {
+			if (!this->waiting_.load(std::memory_order_acquire))
+				return;
+			std::vector<std::function<void()>> waiters;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				waiters.swap(this->waiters_);
+				this->waiting_.store(false, std::memory_order_relaxed);
+			}
+			for (auto& fn : waiters)
+				fn();
+		}
+
+	protected:
+		std::mutex mutex_;
+		std::vector<std::function<void()>> waiters_;
+		std::atomic<bool> waiting_{ false };
+	};
+
+	// 事件环满时session上暂存的事件, 只在session的io线程上使用; 之后的事件也排在后面, 保证同一session的事件按序.
+	class EventBacklog {
+	public:
+		// 压入事件环; 前面还有暂存的事件或者事件环满时暂存, 返回false
+		inline bool push(EventRing& ring, std::function<void()>&& fn) {
+			if (this->events_.empty() && ring.try_push(std::move(fn)))
+				return true;
+			this->events_.emplace_back(std::move(fn));
+			return false;
+		}
+		// 按序重新压入事件环, 全部压入时返回true
+		inline bool flush(EventRing& ring) {
+			while (!this->events_.empty()) {
+				if (!ring.try_push(std::move(this->events_.front())))
+					return false;
+				this->events_.pop_front();
+			}
+			return true;
+		}
+		inline bool empty() const { return this->events_.empty(); }
+		inline std::size_t size() const { return this->events_.size(); }
+		// 是否已在事件环上登记唤醒, 避免重复登记
+		inline bool waiting() const { return this->waiting_; }
+		inline void waiting(bool waiting) { this->waiting_ = waiting; }
+
+	protected:
+		std::deque<std::function<void()>> events_;
+		bool waiting_ = false;
+	};
+
 	class IoPoolImp
 	{
 	public:
-		IoPoolImp(std::size_t concurrency) : iopool_(concurrency) {}
+		IoPoolImp(std::size_t concurrency) : iopool_(concurrency), scheduler_(iopool_) {}
 		~IoPoolImp() = default;
 
+		// 投递无session亲和性的任务, 由空闲io线程窃取执行.
+		template<class Fn>
+		inline void post(Fn&& fn) {
+			this->scheduler_.post(std::forward<Fn>(fn));
+		}
+		// 投递到session所在的io线程执行.
+		template<class SESSIONPTR, class Fn>
+		inline void post_to(SESSIONPTR& session, Fn&& fn) {
+			this->scheduler_.post_to(session, std::forward<Fn>(fn));
+		}
+		template<class Fn>
+		inline void parallel_for(std::size_t begin, std::size_t end, Fn&& fn, std::size_t grain = 0) {
+			this->scheduler_.parallel_for(begin, end, std::forward<Fn>(fn), grain);
+		}
+		inline TaskScheduler& get_scheduler() { return this->scheduler_; }
+
+		// 开启工作线程池, 需在start之前调用. 之后创建的session, 其connect/recv/disconnect回调都在工作线程中执行.
+		inline bool workpool(std::size_t concurrency) {
+			if (this->workpool_)
+				return false;
+			this->workpool_ = std::make_unique<WorkPool>(concurrency);
+			return true;
+		}
+		inline WorkPool* get_workpool() { return this->workpool_.get(); }
+
+		// 外部驱动模式, 需在start之前调用. 之后由应用主循环调用poll驱动所有io事件, 回调在调用poll的线程中执行.
+		inline bool external_poll(bool enable = true) { return this->iopool_.external(enable); }
+		inline std::size_t poll(std::size_t max_events = static_cast<std::size_t>(-1),
+			std::chrono::microseconds budget = std::chrono::microseconds::zero()) {
+			return this->iopool_.poll(max_events, budget);
+		}
+
+		// 开启事件环, 需在start之前调用. 之后创建的session, 其connect/recv/disconnect回调
+		// 由io线程压入事件环, 在调用drain的线程(通常是应用主循环)中执行.
+		// 事件环满时不阻塞io线程: 事件暂存在session上按序重试, tcp session同时暂停读取, 直到暂存的事件都压入事件环;
+		// drain腾出空间后立即唤醒这些session.
+		inline bool event_ring(std::size_t capacity = 65536) {
+			if (this->ering_)
+				return false;
+			this->ering_ = std::make_unique<EventRing>(capacity);
+			return true;
+		}
+		inline EventRing* get_event_ring() { return this->ering_.get(); }
+		// 批量执行事件环中的回调, 只能在同一个线程中调用. 返回执行的事件数.
+		inline std::size_t drain(std::size_t max_events = static_cast<std::size_t>(-1)) {
+			if (!this->ering_)
+				return 0;
+			std::size_t count = 0;
+			std::function<void()> fn;
+			while (count < max_events && this->ering_->pop(fn)) {
+				fn();
+				fn = nullptr;
+				++count;
+			}
+			// 唤醒因事件环满而暂停的session; 登记晚于上次notify的, 下次drain时唤醒
+			this->ering_->notify();
+			return count;
+		}
+
 	protected:
+		// workpool_须晚于iopool_析构: io线程中残留的session持有指向工作线程池的strand.
+		std::unique_ptr<WorkPool> workpool_;
 		IoPool iopool_;
+		TaskScheduler scheduler_;
+		// ering_须早于iopool_析构: 事件环中残留的回调持有session.
+		std::unique_ptr<EventRing> ering_;
 	};
 }
@@ -4,86 +4,309 @@
 * 协议模块：后期需要可以支持外部定义协议.
 */
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
 #include "opt/websocket/websocket.hpp"
 
 namespace net {
-	template<class DRIVERTYPE, class PROTOCOLTYPE, class SVRORCLI>
+	template<class DRIVERTYPE, class PROTOCOLTYPE, class SVRORCLI, class TRAITS = default_traits>
 	class NetProto {
 	public:
 		template<class ... Args>
 		explicit NetProto(Args&&... args) : derive_(static_cast<DRIVERTYPE&>(*this)) {}
 
-		inline void parse_proto(error_code ec, const std::string& s) {
+		inline void parse_proto(error_code ec, std::string&& s) {
 			if (ec) {
-				std::cout << "parse websocket error: " << ec.message() << std::endl;
+				NET_LOG_WARN("parse websocket error: {}", ec);
 				return;
 			}
-			this->derive_.cbfunc()->call(Event::recv, this->derive_.self_shared_ptr(), std::move(s));
+			this->derive_.recv_event(std::move(s));
 		}
 		template<class DATATYPE>
-		inline bool pack_proto(DATATYPE&& data) {
+		inline bool pack_proto(DATATYPE&& data, proto_head& head) {
 			return true;
 		}
+		inline std::unique_lock<std::mutex> pack_guard() {
+			return std::unique_lock<std::mutex>();
+		}
+		// 连接建立后的协议握手(客户端), 没有协议握手时直接完成
+		template<class Fn>
+		inline void proto_handshake(std::string_view host, std::string_view port, Fn&& fn) {
+			fn(error_code());
+		}
+		inline bool proto_pending() const {
+			return false;
+		}
+		// session停止时在io线程上调用
+		inline void proto_stop() {}
 	protected:
 		DRIVERTYPE& derive_;
 	};
 
 	// websocket
-	template<class DRIVERTYPE>
-	class NetProto<DRIVERTYPE, websocket_proto_flag, svr_tab> {
+	template<class DRIVERTYPE, class SVRORCLI, class TRAITS>
+	class NetProto<DRIVERTYPE, websocket_proto_flag, SVRORCLI, TRAITS> {
 	public:
 		template<class ... Args>
-		explicit NetProto(Args&&... args) : derive_(static_cast<DRIVERTYPE&>(*this)) {}
+		explicit NetProto(Args&&... args) : derive_(static_cast<DRIVERTYPE&>(*this)) {
+			ws_.max_message_size(TRAITS::ws_max_message_size);
+			ws_.validate_utf8(TRAITS::ws_validate_utf8);
+			ws_.stream_size(TRAITS::stream_recv_size);
+#if defined(NET_USE_ZLIB)
+			using deflate_traits = typename TRAITS::ws_deflate;
+			if constexpr (deflate_traits::enable) {
+				ws_deflate_options opts;
+				opts.level = deflate_traits::level;
+				opts.mem_level = deflate_traits::mem_level;
+				opts.server_max_window_bits = deflate_traits::server_max_window_bits;
+				opts.client_max_window_bits = deflate_traits::client_max_window_bits;
+				opts.server_no_context_takeover = deflate_traits::server_no_context_takeover;
+				opts.client_no_context_takeover = deflate_traits::client_no_context_takeover;
+				opts.min_size = deflate_traits::min_size;
+				ws_.deflate_options(opts);
+			}
+#endif
+		}
 
-		inline void parse_proto(error_code ec, const std::string& s) {
+		inline void parse_proto(error_code ec, std::string&& s) {
 			if (ec) {
-				std::cout << "parse websocket error: " << ec.message() << std::endl;
+				NET_LOG_WARN("parse websocket error: {}", ec);
 				return;
 			}
-			if (shared_flag_ == 0) {
-				if (std::strstr(s.data(), "Upgrade: websocket") != NULL) {//握手处理
-					ws_.parse_http_info(s.c_str());
-					std::string respose;
-					auto ret = ws_.get_handshark_pack(respose);
-					if (ret) {
-						this->derive_.send(respose);
-						shared_flag_ = 1;
+			if (shared_flag_ < 0) {// 关闭握手之后不再处理收到的数据
+				return;
+			}
+			if constexpr (TRAITS::ws_ping_interval > 0) {
+				this->last_active_ = this->derive_.cio().wheel().now();
+			}
+			if (shared_flag_ == 0) {//握手处理, 请求/响应可能分多次到达, 之后可能紧跟着帧
+				if (!this->on_handshake(s, ec)) {
+					if (ec) {
+						NET_LOG_WARN("websocket handshake error: {}", ec);
+						set_last_error(ec);
+						if (this->handshake_cb_)
+							std::exchange(this->handshake_cb_, nullptr)(ec);
+						else
+							this->derive_.stop(ec);
 					}
+					return;
+				}
+				if (s.empty()) {
+					return;
 				}
-				return;
 			}
-			ws_.parse(s, [this](int opcode, std::string& data) {
-				if (opcode == 8) { //关闭握手
+			// 一次读到的所有完整帧都在这里派发, 控制帧直接回复
+			ec = ws_.parse(s, [this](ws_opcode opcode, std::string_view data) {
+				switch (opcode) {
+				case ws_opcode::close: //关闭握手
 					ws_.close_log(data);
-					this->derive_.send(data);
-					shared_flag_ = 0;
-					return;
+					// 回复close帧, 写完后断开; 之后收到的数据都忽略
+					shared_flag_ = -1;
+					this->derive_.send_last(ws_.pack_control(ws_opcode::close, data), asio::error::eof);
+					break;
+				case ws_opcode::ping:
+					this->derive_.send_urgent(ws_.pack_control(ws_opcode::pong, data));
+					break;
+				case ws_opcode::pong:
+					break;
+				default:
+					this->derive_.recv_event(std::string(data));
+					break;
+				}
+			}, [this](ws_stream_part part, std::uint64_t size, std::string_view data) {
+				switch (part) {
+				case ws_stream_part::begin:
+					this->derive_.stream_begin(size);
+					break;
+				case ws_stream_part::chunk:
+					this->derive_.stream_chunk(data);
+					break;
+				case ws_stream_part::end:
+					this->derive_.stream_end();
+					break;
 				}
-				this->derive_.cbfunc()->call(Event::recv, this->derive_.self_shared_ptr(), std::move(data));
 			});
+			if (ec) {
+				NET_LOG_WARN("parse websocket frame error: {}", ec);
+				set_last_error(ec);
+				this->derive_.stop(ec);
+			}
 		}
 		template<class DATATYPE>
-		inline bool pack_proto(DATATYPE&& data) {
+		inline bool pack_proto(DATATYPE&& data, proto_head& head) {
+			if (shared_flag_ <= 0) {// 握手完成之前/关闭之后
+				set_last_error(asio::error::not_connected);
+				return false;
+			}
+			if (ws_.compress_message(std::string_view(data), head.body)) {
+				return ws_.get_pack_head(head.body.size(), head, true);
+			}
+			head.body.clear();
+			if (!ws_.get_pack_head(std::string_view(data).size(), head)) {
+				ws_.get_pack_masked(std::string_view(data), head);
+			}
+			return true;
+		}
+		// 客户端: tcp(ssl)连接建立后发出升级请求, 收到合法的响应后回调fn
+		template<class Fn>
+		inline void proto_handshake(std::string_view host, std::string_view port, Fn&& fn) {
+			if constexpr (is_cli_v<SVRORCLI>) {
+				std::string hostport(host);
+				if (port != "80" && port != "443")
+					hostport.append(":").append(port);
+				// 重连时复用session, 重新从握手开始
+				shared_flag_ = 0;
+				ws_.reset();
+				ws_handshake_response request;
+				if (!ws_.pack_upgrade_request(hostport, this->path_, request)) {
+					fn(error_code(asio::error::invalid_argument));
+					return;
+				}
+				this->handshake_cb_ = std::forward<Fn>(fn);
+				this->derive_.send_packed(request.view());
+			}
+			else {
+				fn(error_code());
+			}
+		}
+		inline bool proto_pending() const {
+			return shared_flag_ == 0 && this->handshake_cb_ != nullptr;
+		}
+		inline void proto_stop() {
+			if constexpr (TRAITS::ws_ping_interval > 0) {
+				this->derive_.cio().wheel().cancel(this->ping_node_);
+			}
+		}
+		// 分片发送一条大消息: source(buf, size)在io线程里按需填充下一片的负载(不超过size), 返回0表示消息结束.
+		// 同时只有一片(TRAITS::ws_fragment_size)在内存里, 片与片之间可以插入ping/pong;
+		// RFC 6455不允许数据消息交错, 之后send的消息等这条发完. 分片发送的消息不压缩.
+		template<class Source>
+		inline bool send_stream(Source&& source, ws_opcode opcode = ws_opcode::binary) {
 			if (shared_flag_ <= 0) {
-				return true;
+				set_last_error(asio::error::not_connected);
+				return false;
 			}
-			std::string buffer;
-			int packlen = ws_.get_pack_data(std::forward<DATATYPE>(data), buffer);
-			if (packlen > 0) {
-				data = std::move(buffer);
+			using ws_type = decltype(ws_);
+			return this->derive_.send_chunked([this, source = std::forward<Source>(source), opcode,
+				buf = std::string(), first = true, done = false](std::string_view& chunk) mutable {
+				if (done || shared_flag_ <= 0)	// 已经关闭时停下, 让close帧发出
+					return false;
+				if (buf.empty())
+					buf.resize(ws_type::max_head_size + TRAITS::ws_fragment_size);
+				std::size_t len = (std::min)(source(buf.data() + ws_type::max_head_size, TRAITS::ws_fragment_size), TRAITS::ws_fragment_size);
+				done = (len == 0);
+				chunk = ws_.pack_fragment(buf.data(), len, first ? opcode : ws_opcode::continuation, done);
+				first = false;
 				return true;
+			});
+		}
+		// 分片发送文件内容, 边读边发; 打不开时返回false
+		inline bool send_file(const std::string& path, ws_opcode opcode = ws_opcode::binary) {
+			std::FILE* fp = std::fopen(path.c_str(), "rb");
+			if (fp == nullptr) {
+				set_last_error(errno);
+				return false;
+			}
+			std::shared_ptr<std::FILE> file(fp, &std::fclose);
+			return this->send_stream([file](char* buf, std::size_t size) {
+				return std::fread(buf, 1, size, file.get());
+			}, opcode);
+		}
+		// 客户端: 升级请求的路径, 在连接之前设置
+		inline void ws_path(std::string_view path) {
+			this->path_ = path;
+		}
+
+		// 复用压缩上下文时, 压缩和入队要在同一把锁下, 保证对端按压缩顺序解压
+		inline std::unique_lock<std::mutex> pack_guard() {
+#if defined(NET_USE_ZLIB)
+			if (shared_flag_ > 0 && ws_.deflate().need_send_order())
+				return std::unique_lock<std::mutex>(ws_.deflate().send_mutex());
+#endif
+			return std::unique_lock<std::mutex>();
+		}
+	protected:
+		inline bool on_handshake(std::string& s, error_code& ec) {
+			if constexpr (is_cli_v<SVRORCLI>) {
+				if (!ws_.handshake_response(s, ec))
+					return false;
+				shared_flag_ = 1;
+				this->keepalive_start();
+				if (this->handshake_cb_)
+					std::exchange(this->handshake_cb_, nullptr)(ec);
+			}
+			else {
+				ws_handshake_response response;
+				if (!ws_.handshake(s, response, ec))
+					return false;
+				this->derive_.send_packed(response.view());
+				shared_flag_ = 1;
+				this->keepalive_start();
+			}
+			return true;
+		}
+
+		// 心跳: 挂在io线程共用的时间轮上, 每个连接每个周期只调度一次, 收包路径只记录时间
+		inline void keepalive_start() {
+			if constexpr (TRAITS::ws_ping_interval > 0) {
+				this->ping_sent_ = false;
+				this->ping_node_.callback([this]() { this->keepalive_check(); });
+				this->derive_.cio().wheel().schedule(this->ping_node_, TRAITS::ws_ping_interval, this->derive_.shared_from_this());
+			}
+		}
+		inline void keepalive_check() {
+			if (shared_flag_ <= 0) {
+				return;
+			}
+			auto& wheel = this->derive_.cio().wheel();
+			std::int64_t now = wheel.now();
+			if (this->ping_sent_) {
+				if (this->last_active_ >= this->ping_at_) {
+					this->ping_sent_ = false;	// ping之后收到过数据(pong或者其他帧)
+				}
+				else if (now - this->ping_at_ >= TRAITS::ws_ping_timeout) {
+					NET_LOG_INFO("websocket ping timeout");
+					set_last_error(asio::error::timed_out);
+					this->derive_.stop(asio::error::timed_out);
+					return;
+				}
+				else {
+					wheel.schedule(this->ping_node_, this->ping_at_ + TRAITS::ws_ping_timeout - now, this->derive_.shared_from_this());
+					return;
+				}
+			}
+			std::int64_t idle = now - this->last_active_;
+			if (idle >= TRAITS::ws_ping_interval) {
+				this->derive_.send_urgent(ws_.pack_control(ws_opcode::ping, std::string_view()));
+				this->ping_sent_ = true;
+				this->ping_at_ = now;
+				wheel.schedule(this->ping_node_, TRAITS::ws_ping_timeout, this->derive_.shared_from_this());
+			}
+			else {
+				wheel.schedule(this->ping_node_, TRAITS::ws_ping_interval - idle, this->derive_.shared_from_this());
 			}
-			return false;
 		}
 	protected:
 		DRIVERTYPE& derive_;
-		WebSocket ws_;
-		std::atomic<std::size_t> shared_flag_{ 0 };
+		basic_websocket<traits_stream_buffer_t<TRAITS>> ws_;
+		std::atomic<int> shared_flag_{ 0 };			//0: 握手, 1: 已升级, -1: 已关闭
+		std::function<void(const error_code&)> handshake_cb_;	//客户端: 升级完成的回调
+		std::string path_ = "/";
+		TimerWheel::node ping_node_;
+		std::int64_t last_active_ = 0;		//最近收到数据的时间(时间轮毫秒)
+		std::int64_t ping_at_ = 0;
+		bool ping_sent_ = false;
 	};
 
 	// http(有待实现)
-	template<class DRIVERTYPE, class SVRORCLI>
-	class NetProto<DRIVERTYPE, http_proto_flag, SVRORCLI> {
+	template<class DRIVERTYPE, class SVRORCLI, class TRAITS>
+	class NetProto<DRIVERTYPE, http_proto_flag, SVRORCLI, TRAITS> {
 	public:
 		template<class ... Args>
 		explicit NetProto(Args&&... args) : derive_(static_cast<DRIVERTYPE&>(*this)) {}
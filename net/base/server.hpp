@@ -6,14 +6,14 @@
 #include "base/acceptor.hpp"
 
 namespace net {
-	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void>
+	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void, class TRAITS = default_traits>
 	class Server : public IoPoolImp
 				 , public NetStream<SOCKETTYPE, STREAMTYPE>
-				 , public Acceptor<Server<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, SOCKETTYPE>
-				 , public std::enable_shared_from_this<Server<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE> > {
+				 , public Acceptor<Server<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, SOCKETTYPE>
+				 , public std::enable_shared_from_this<Server<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS> > {
 	public:
-		using server_type = Server<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>;
-		using session_type = Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>;
+		using server_type = Server<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>;
+		using session_type = Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>;
 		using session_ptr_type = std::shared_ptr<session_type>;
 		using session_weakptr_type = std::weak_ptr<session_type>;
 		using acceptor_type = Acceptor<server_type, session_type, SOCKETTYPE>;
@@ -30,40 +30,35 @@ namespace net {
 			
 		{
 			this->iopool_.start();
-			this->cbfunc_ = std::make_shared<CBPROXYTYPE>();
+			this->cbfunc_ = std::make_shared<typename session_type::event_table_type>();
 		}
 
 		~Server() {
 			this->iopool_.stop();
+			if (this->workpool_)
+				this->workpool_->stop();
 		}
 
 		inline bool start(std::string_view host, std::string_view service) {
-			try {
-				State expected = State::stopped;
-				if (!this->state_.compare_exchange_strong(expected, State::starting)) {
-					set_last_error(asio::error::already_started);
-					return false;
-				}
-			
-				clear_last_error();
-
-				//cbfunc_->call(Event::init);
+			State expected = State::stopped;
+			if (!this->state_.compare_exchange_strong(expected, State::starting)) {
+				set_last_error(asio::error::already_started);
+				return false;
+			}
+		
+			clear_last_error();
 
-				this->acceptor_start(host, service);
+			//cbfunc_->call(Event::init);
 
-				expected = State::starting;
-				if (!this->state_.compare_exchange_strong(expected, State::started)) {
-					set_last_error(asio::error::operation_aborted);
-					return false;
-				}
+			this->acceptor_start(host, service);
 
-				return (this->is_started());
+			expected = State::starting;
+			if (!this->state_.compare_exchange_strong(expected, State::started)) {
+				set_last_error(asio::error::operation_aborted);
+				return false;
 			}
-			catch (system_error & e) {
-				set_last_error(e);
-				this->stop(e.code());
-			}
-			return false;
+
+			return (this->is_started());
 		}
 
 		inline void stop(error_code ec) {
@@ -107,6 +102,12 @@ namespace net {
 			return (this->state_ == State::stopped && !this->is_open());
 		}
 
+		// 启动中或已启动: acceptor的投递在start返回之前就可能被io线程执行.
+		inline bool is_running() const {
+			State state = this->state_;
+			return ((state == State::starting || state == State::started) && this->is_open());
+		}
+
 		//广播所有session
 		inline void broadcast(const std::string_view && data) {
 			this->sessions_.foreach([&data](session_ptr_type& session_ptr) {
@@ -115,6 +116,14 @@ namespace net {
 		}
 
 		inline session_ptr_type make_session() {
+			session_ptr_type session_ptr = this->create_session();
+			session_ptr->workpool(this->workpool_.get());
+			session_ptr->event_ring(this->ering_.get());
+			session_ptr->router(this->router_.get());
+			return session_ptr;
+		}
+
+		inline session_ptr_type create_session() {
 			if constexpr (is_udp_socket_v<SOCKETTYPE>) {
 				if constexpr (is_kcp_streamtype_v<STREAMTYPE>) {
 					return std::make_shared<session_type>(this->sessions_, this->cbfunc_, this->accept_io_, this->max_buffer_size_, this->remote_endpoint_, this->accept_io_, this->acceptor_);
@@ -151,19 +160,31 @@ namespace net {
 			return session_ptr_type(this->sessions_.find_if(fn));
 		}
 
-		/*inline void post(std::function<void()>&& task) {
-			asio::post(this->io_.strand(), [task=std::move(task)]() { task(); });
-		}*/
-
 		template<class ...Args>
 		bool bind(Args&&... args) {
 			return cbfunc_->bind(std::forward<Args>(args)...);
 		}
+		// 编译期检查回调签名: bind<Event::recv>(f)
+		template<Event E, class ...Args>
+		bool bind(Args&&... args) {
+			return cbfunc_->template bind<E>(std::forward<Args>(args)...);
+		}
 
 		template<class ...Args>
 		bool call(Args&&... args) {
 			return cbfunc_->call(std::forward<Args>(args)...);
 		}
+		template<Event E, class ...Args>
+		void call(Args&&... args) {
+			cbfunc_->template call<E>(std::forward<Args>(args)...);
+		}
+
+		// 消息路由, 需在start之前注册. 开启后收到的数据按(len, msg_id)分帧派发到注册的处理函数.
+		inline typename session_type::router_type& router() {
+			if (!this->router_)
+				this->router_ = std::make_unique<typename session_type::router_type>();
+			return *this->router_;
+		}
 
 		auto& get_iopool() { return iopool_; }
 		auto& get_sessions() { return sessions_; }
@@ -178,7 +199,9 @@ namespace net {
 		std::size_t max_buffer_size_ = 0;
 		std::size_t min_buffer_size_ = 0;
 
-		FuncProxyImpPtr cbfunc_;
+		typename session_type::event_table_ptr_type cbfunc_;
+
+		std::unique_ptr<typename session_type::router_type> router_;
 	};
 }
 
@@ -1,9 +1,9 @@
 #pragma once
 
-#include <any>
 #include <memory>
 #include <functional>
 #include <queue>
+#include <optional>
 #include <string_view>
 
 #include "base/iopool.hpp"
@@ -12,25 +12,36 @@
 #include "base/session_mgr.hpp"
 #include "base/transfer_data.hpp"
 #include "base/proto.hpp"
+#include "base/event_table.hpp"
+#include "base/user_context.hpp"
+#include "base/session_stats.hpp"
+#include "base/session_event.hpp"
 #include "tool/bytebuffer.hpp"
 
 namespace net {
-	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void>
-	class Session : public StreamType<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, SOCKETTYPE, STREAMTYPE, svr_tab>
-				  , public TransferData<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, svr_tab>
-				  , public NetProto<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>, PROTOCOLTYPE, svr_tab>
-				  , public std::enable_shared_from_this<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>> {
+	template<class SOCKETTYPE, class STREAMTYPE = void, class PROTOCOLTYPE = void, class TRAITS = default_traits>
+	class Session : public StreamType<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, SOCKETTYPE, STREAMTYPE, svr_tab>
+				  , public TransferData<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, svr_tab, TRAITS>
+				  , public NetProto<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>, PROTOCOLTYPE, svr_tab, TRAITS>
+				  , public UserContext<typename TRAITS::user_context_type>
+				  , public SessionStats<TRAITS::stats>
+				  , public SessionEvent<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>>
+				  , public std::enable_shared_from_this<Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>> {
 	public:
-		using session_type = Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE>;
+		using session_type = Session<SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, TRAITS>;
 		using session_ptr_type = std::shared_ptr<session_type>;
+		using traits_type = TRAITS;
+		using buffer_type = traits_buffer_t<TRAITS>;
+		using event_table_type = event_table<session_ptr_type, typename TRAITS::event_policy>;
+		using event_table_ptr_type = std::shared_ptr<event_table_type>;
 		using stream_type = StreamType<session_type, SOCKETTYPE, STREAMTYPE, svr_tab>;
-		using transferdata_type = TransferData<session_type, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, svr_tab>;
+		using transferdata_type = TransferData<session_type, SOCKETTYPE, STREAMTYPE, PROTOCOLTYPE, svr_tab, TRAITS>;
 		using sessionmgr_type = SessionMgr<session_type>;
 		//using key_type = typename std::conditional<is_udp_socket_v<SOCKETTYPE>, asio::ip::udp::endpoint, std::size_t>::type;
 		using key_type = std::size_t;
 	public:
 		template<class ...Args>
-		explicit Session(sessionmgr_type& sessions, FuncProxyImpPtr & cbfunc, NIO & io,
+		explicit Session(sessionmgr_type& sessions, event_table_ptr_type& cbfunc, NIO & io,
 						std::size_t max_buffer_size, Args&&... args)
 			: stream_type(std::forward<Args>(args)...)
 			, transferdata_type(max_buffer_size)
@@ -47,54 +58,62 @@ namespace net {
 		inline bool start(error_code ec) {
 			//if (!this->cio_.strand().running_in_this_thread())
 			//	return asio::post(this->cio_.strand(), std::bind(&session_type::start<iskeepalive>, this, std::move(ec)));
-			try {
-				asio::detail::throw_error(ec);
-				State expected = State::stopped;
-				if (!ec && !this->state_.compare_exchange_strong(expected, State::starting))
-					asio::detail::throw_error(asio::error::already_started);
-				//cbfunc_->call(Event::accept, dptr, ec);
-
-				if constexpr (iskeepalive && is_tcp_socket_v<SOCKETTYPE>)
-					this->keep_alive_options();
-				else
-					std::ignore = true;
-
-				const auto& dptr = this->shared_from_this();
-				this->stream_post_handshake(dptr, [this, dptr = this->shared_from_this()](const error_code& ec) {
-					try {
-						State expected = State::starting;
-						if (!ec && !this->state_.compare_exchange_strong(expected, State::started))
-							asio::detail::throw_error(asio::error::operation_aborted);
+			State expected = State::stopped;
+			if (!ec && !this->state_.compare_exchange_strong(expected, State::starting))
+				ec = asio::error::already_started;
+			if (ec) {
+				set_last_error(ec);
+				this->stop(ec);
+				return false;
+			}
+			//cbfunc_->call(Event::accept, dptr, ec);
 
-						cbfunc_->call(Event::connect, dptr, ec);
+			if constexpr (iskeepalive && is_tcp_socket_v<SOCKETTYPE>)
+				this->keep_alive_options();
+			else
+				std::ignore = true;
 
-						asio::detail::throw_error(ec);
+			if constexpr (is_tcp_socket_v<SOCKETTYPE>) {
+				if (this->cio_.busy_poll().sock_usec > 0)
+					this->busy_poll(this->cio_.busy_poll().sock_usec);
+			}
 
-						//加入到sessionmgr
-						bool isadd = this->sessions_.emplace(dptr);
-						if (isadd)
-							this->do_recv();
-						else
-							this->stop(asio::error::address_in_use);
-					}
-					catch (system_error& e) {
-						set_last_error(e);
-						this->stop(e.code());
-					}
+			const auto& dptr = this->shared_from_this();
+			this->stream_post_handshake(dptr, [this, dptr = this->shared_from_this()](const error_code& ec) {
+				State expected = State::starting;
+				if (!ec && !this->state_.compare_exchange_strong(expected, State::started)) {
+					set_last_error(asio::error::operation_aborted);
+					this->stop(asio::error::operation_aborted);
+					return;
+				}
+
+				this->post_event([this, dptr, ec]() mutable {
+					cbfunc_->template call<Event::connect>(dptr, ec);
 				});
-				return true;
-			}
-			catch (system_error& e) {
-				set_last_error(e);
-				this->stop(e.code());
-			}
-			return false;
+
+				if (ec) {
+					set_last_error(ec);
+					this->stop(ec);
+					return;
+				}
+
+				//加入到sessionmgr
+				bool isadd = this->sessions_.emplace(dptr);
+				if (isadd)
+					this->do_recv();
+				else
+					this->stop(asio::error::address_in_use);
+			});
+			return true;
 		}
 
 		inline void stop(const error_code& ec) {
 			auto handlefunc = [this](session_ptr_type sessionptr, const error_code& ec, State oldstate) {
-				asio::post(this->cio_.strand(),
+				asio::post(this->io_executor(),
 				[this, ec, dptr = std::move(sessionptr), oldstate]() {
+					this->proto_stop();
+					this->urgent_clear();
+					this->recv_paused_ = false;
 					//从sessionmgr移除
 					bool isremove = this->sessions_.erase(dptr);
 					if (!isremove) {
@@ -104,12 +123,18 @@ namespace net {
 					State expected = State::stopping;
 					if (this->state_.compare_exchange_strong(expected, State::stopped)) {
 						if (oldstate == State::started)
-							cbfunc_->call(Event::disconnect, dptr, ec);
+							this->post_event([this, dptr, ec]() mutable {
+								cbfunc_->template call<Event::disconnect>(dptr, ec);
+							});
 					}
 					else {
 						NET_ASSERT(false);
 					}
-					this->user_data_reset();
+					// 在disconnect之后重置, 路由缓存里没收完的半帧一起丢弃
+					this->post_event([this, dptr]() {
+						this->user_data_reset();
+						this->rbuff_.reset();
+					});
 					this->stream_stop(dptr);
 				});
 			};
@@ -142,40 +167,28 @@ namespace net {
 		//imp
 		inline auto self_shared_ptr() { return this->shared_from_this(); }
 		inline NIO& cio() { return cio_; }
+		// session的io回调执行器, 由TRAITS::use_strand决定是否经过strand
+		inline decltype(auto) io_executor() {
+			if constexpr (TRAITS::use_strand)
+				return (this->cio_.strand());
+			else
+				return this->cio_.context().get_executor();
+		}
 		inline void set_first_pack(std::string&& str) { first_pack_ = std::move(str); }
 		inline auto& get_first_pack() { return first_pack_; }
-		inline t_buffer_cmdqueue<>& rbuffer() { return rbuff_; }
+		inline buffer_type& rbuffer() { return rbuff_; }
 		inline auto& cbfunc() { return cbfunc_; }
 
-
-		template<class DataT>
-		inline void user_data(DataT && data) {
-			this->user_data_ = std::forward<DataT>(data);
-		}
-		template<class DataT>
-		inline DataT* user_data() {
-			try {
-				return std::any_cast<DataT>(&this->user_data_);
-			}
-			catch (const std::bad_any_cast&) {}
-			return nullptr;
-		}
-		inline void user_data_reset() {
-			this->user_data_.reset();
-		}
-
 	protected:
 		NIO & cio_;
 
-		FuncProxyImpPtr & cbfunc_;
+		event_table_ptr_type& cbfunc_;
 		
 		sessionmgr_type& sessions_;
 
 		std::atomic<State> state_ = State::stopped;
 
-		t_buffer_cmdqueue<> rbuff_;
-
-		std::any user_data_;
+		buffer_type rbuff_;
 
 		std::string first_pack_;
 	};
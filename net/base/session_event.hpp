@@ -0,0 +1,129 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <functional>
+
+#include "base/iopool.hpp"
+#include "base/event_table.hpp"
+#include "tool/msg_router.hpp"
+
+namespace net {
+	// session的事件派发：Session和CSession共用.
+	// 开启事件环时压入事件环; 开启工作线程池时投递到该session的strand上; 否则直接在io线程中执行.
+	template<class DRIVERTYPE>
+	class SessionEvent {
+	public:
+		using router_type = msg_router<std::shared_ptr<DRIVERTYPE>>;
+
+		SessionEvent() : derive_(static_cast<DRIVERTYPE&>(*this)) {}
+		~SessionEvent() = default;
+
+		inline void workpool(WorkPool* pool) {
+			if (pool)
+				this->wstrand_.emplace(pool->make_strand());
+		}
+		inline void event_ring(EventRing* ring) { this->ering_ = ring; }
+		inline void router(router_type* router) { this->router_ = router; }
+		// 事件环满时暂存在session上重试
+		template<class Fn>
+		inline void post_event(Fn&& fn) {
+			if (this->ering_) {
+				if (!this->backlog_.push(*this->ering_, std::function<void()>(std::forward<Fn>(fn))))
+					this->ering_retry();
+				return;
+			}
+			if (this->wstrand_) {
+				asio::post(*this->wstrand_, std::forward<Fn>(fn));
+				return;
+			}
+			fn();
+		}
+		inline void recv_event(std::string&& s) {
+			this->derive_.stats_recv(s.size());
+			// 开启消息路由时, 在事件派发的线程中分帧, 不再触发Event::recv
+			if (this->router_) {
+				this->post_event([this, dptr = this->derive_.self_shared_ptr(), data = std::move(s)]() mutable {
+					if (!this->router_->dispatch(dptr, this->derive_.rbuffer(), data.data(), data.size()))
+						this->derive_.stop(asio::error::message_size);
+				});
+				return;
+			}
+			if (this->ering_ || this->wstrand_) {
+				this->post_event([this, dptr = this->derive_.self_shared_ptr(), data = std::move(s)]() mutable {
+					this->derive_.cbfunc()->template call<Event::recv>(dptr, std::move(data));
+				});
+				return;
+			}
+			auto dptr = this->derive_.self_shared_ptr();
+			this->derive_.cbfunc()->template call<Event::recv>(dptr, std::move(s));
+		}
+		// 流式接收(TRAITS::stream_recv_size): 和recv一样派发, 派发到其他线程时chunk要拷贝一份
+		inline void stream_begin(std::uint64_t size) {
+			this->post_event([this, dptr = this->derive_.self_shared_ptr(), size]() mutable {
+				this->derive_.cbfunc()->template call<Event::recv_begin>(dptr, size);
+			});
+		}
+		inline void stream_chunk(std::string_view data) {
+			this->derive_.stats_recv(data.size());
+			if (this->ering_ || this->wstrand_) {
+				this->post_event([this, dptr = this->derive_.self_shared_ptr(), data = std::string(data)]() mutable {
+					this->derive_.cbfunc()->template call<Event::recv_chunk>(dptr, std::string_view(data));
+				});
+				return;
+			}
+			auto dptr = this->derive_.self_shared_ptr();
+			this->derive_.cbfunc()->template call<Event::recv_chunk>(dptr, data);
+		}
+		inline void stream_end() {
+			this->post_event([this, dptr = this->derive_.self_shared_ptr()]() mutable {
+				this->derive_.cbfunc()->template call<Event::recv_end>(dptr);
+			});
+		}
+		// 有暂存的事件时暂停读取, 全部压入事件环后由ering_flush恢复
+		inline bool recv_paused() {
+			if (this->backlog_.empty())
+				return false;
+			this->recv_paused_ = true;
+			return true;
+		}
+
+	protected:
+		// 事件环满: 在事件环上登记唤醒, drain腾出空间后回到io线程重试, 期间session保持存活
+		inline void ering_retry() {
+			if (this->backlog_.waiting())
+				return;
+			this->backlog_.waiting(true);
+			this->ering_->wait([this, dptr = this->derive_.self_shared_ptr()]() {
+				asio::post(this->derive_.io_executor(), [this, dptr]() {
+					this->backlog_.waiting(false);
+					this->ering_flush();
+				});
+			});
+		}
+		inline void ering_flush() {
+			if (!this->backlog_.flush(*this->ering_)) {
+				this->ering_retry();
+				return;
+			}
+			if (std::exchange(this->recv_paused_, false) && this->derive_.is_started())
+				this->derive_.do_recv();
+		}
+
+	protected:
+		DRIVERTYPE& derive_;
+
+		std::optional<WorkPool::strand_type> wstrand_;
+
+		EventRing* ering_ = nullptr;
+
+		EventBacklog backlog_;
+
+		bool recv_paused_ = false;
+
+		router_type* router_ = nullptr;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace net {
+	// session收发统计, 由TRAITS::stats开启; 关闭时为空类, 不占空间也没有额外的原子操作.
+	// 在io线程中累加, 可以在任意线程读取.
+	template<bool ENABLE>
+	class SessionStats {
+	public:
+		inline std::uint64_t recv_bytes() const { return this->recv_bytes_.load(std::memory_order_relaxed); }
+		inline std::uint64_t recv_count() const { return this->recv_count_.load(std::memory_order_relaxed); }
+		inline std::uint64_t send_bytes() const { return this->send_bytes_.load(std::memory_order_relaxed); }
+		inline std::uint64_t send_count() const { return this->send_count_.load(std::memory_order_relaxed); }
+
+		inline void stats_recv(std::size_t bytes) {
+			this->recv_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+			this->recv_count_.fetch_add(1, std::memory_order_relaxed);
+		}
+		inline void stats_send(std::size_t bytes) {
+			this->send_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+			this->send_count_.fetch_add(1, std::memory_order_relaxed);
+		}
+
+	protected:
+		std::atomic<std::uint64_t> recv_bytes_{ 0 };
+		std::atomic<std::uint64_t> recv_count_{ 0 };
+		std::atomic<std::uint64_t> send_bytes_{ 0 };
+		std::atomic<std::uint64_t> send_count_{ 0 };
+	};
+
+	template<>
+	class SessionStats<false> {
+	public:
+		inline void stats_recv(std::size_t) {}
+		inline void stats_send(std::size_t) {}
+	};
+}
@@ -29,43 +29,31 @@ namespace net {
 		}
 
 		inline std::string local_address() {
-			try {
-				return this->socket_.lowest_layer().local_endpoint().address().to_string();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return std::string(" ");
+			error_code ec;
+			auto endpoint = this->socket_.lowest_layer().local_endpoint(ec);
+			set_last_error(ec);
+			return ec ? std::string(" ") : endpoint.address().to_string();
 		}
 
 		inline unsigned short local_port() {
-			try {
-				return this->socket_.lowest_layer().local_endpoint().port();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return static_cast<unsigned short>(0);
+			error_code ec;
+			auto endpoint = this->socket_.lowest_layer().local_endpoint(ec);
+			set_last_error(ec);
+			return ec ? static_cast<unsigned short>(0) : endpoint.port();
 		}
 
 		inline std::string remote_address() {
-			try {
-				return this->socket_.lowest_layer().remote_endpoint().address().to_string();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return std::string(" ");
+			error_code ec;
+			auto endpoint = this->socket_.lowest_layer().remote_endpoint(ec);
+			set_last_error(ec);
+			return ec ? std::string(" ") : endpoint.address().to_string();
 		}
 
 		inline unsigned short remote_port() {
-			try {
-				return this->socket_.lowest_layer().remote_endpoint().port();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return static_cast<unsigned short>(0);
+			error_code ec;
+			auto endpoint = this->socket_.lowest_layer().remote_endpoint(ec);
+			set_last_error(ec);
+			return ec ? static_cast<unsigned short>(0) : endpoint.port();
 		}
 
 		void close() {
@@ -75,116 +63,79 @@ namespace net {
 
 	public:
 		inline void sndbuf_size(int val) {
-			try {
-				this->socket_.lowest_layer().set_option(asio::socket_base::send_buffer_size(val));
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
+			this->set_option(asio::socket_base::send_buffer_size(val));
 		}
 		inline int sndbuf_size() const {
-			try {
-				asio::socket_base::send_buffer_size option;
-				this->socket_.lowest_layer().get_option(option);
-				return option.value();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return (-1);
+			asio::socket_base::send_buffer_size option;
+			return this->get_option(option) ? option.value() : (-1);
 		}
 
 		inline void rcvbuf_size(int val) {
-			try {
-				this->socket_.lowest_layer().set_option(asio::socket_base::receive_buffer_size(val));
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
+			this->set_option(asio::socket_base::receive_buffer_size(val));
 		}
 		inline int rcvbuf_size() const {
-			try {
-				asio::socket_base::receive_buffer_size option;
-				this->socket_.lowest_layer().get_option(option);
-				return option.value();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return (-1);
+			asio::socket_base::receive_buffer_size option;
+			return this->get_option(option) ? option.value() : (-1);
 		}
 
 		inline void reuse_address(bool val) {
-			try {
-				this->socket_.lowest_layer().set_option(asio::socket_base::reuse_address(val));
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
+			this->set_option(asio::socket_base::reuse_address(val));
 		}
 
 		inline bool reuse_address() const {
-			try {
-				asio::socket_base::reuse_address option;
-				this->socket_.lowest_layer().get_option(option);
-				return option.value();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return false;
+			asio::socket_base::reuse_address option;
+			return this->get_option(option) ? option.value() : false;
 		}
 
 		inline void no_delay(bool val) {
-			try {
-				if constexpr (std::is_same_v<typename socket_type::protocol_type, asio::ip::tcp>) {
-					this->socket_.lowest_layer().set_option(asio::ip::tcp::no_delay(val));
-				}
-				else {
-					std::ignore = true;
-					//static_assert(false, "Only tcp socket has the no_delay option");
-				}
+			if constexpr (std::is_same_v<typename socket_type::protocol_type, asio::ip::tcp>) {
+				this->set_option(asio::ip::tcp::no_delay(val));
 			}
-			catch (system_error & e) {
-				set_last_error(e);
+			else {
+				std::ignore = val;
+				//static_assert(false, "Only tcp socket has the no_delay option");
 			}
 		}
 		inline bool no_delay() const {
-			try {
-				if constexpr (std::is_same_v<typename socket_type::protocol_type, asio::ip::tcp>) {
-					asio::ip::tcp::no_delay option;
-					this->socket_.lowest_layer().get_option(option);
-					return option.value();
-				}
-				else {
-					std::ignore = true;
-					//static_assert(false, "Only tcp socket has the no_delay option");
-				}
+			if constexpr (std::is_same_v<typename socket_type::protocol_type, asio::ip::tcp>) {
+				asio::ip::tcp::no_delay option;
+				return this->get_option(option) ? option.value() : false;
 			}
-			catch (system_error & e) {
-				set_last_error(e);
+			else {
+				//static_assert(false, "Only tcp socket has the no_delay option");
+				return false;
 			}
-			return false;
 		}
 
 		inline void keep_alive(bool val) {
-			try {
-				this->socket_.lowest_layer().set_option(asio::socket_base::keep_alive(val));
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
+			this->set_option(asio::socket_base::keep_alive(val));
 		}
 		inline bool keep_alive() const {
-			try {
-				asio::socket_base::keep_alive option;
-				this->socket_.lowest_layer().get_option(option);
-				return option.value();
-			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
+			asio::socket_base::keep_alive option;
+			return this->get_option(option) ? option.value() : false;
+		}
+
+		// linux下的忙轮询选项: 读socket时在驱动队列上自旋usec微秒, 降低唤醒延迟.
+		inline bool busy_poll(int usec, bool prefer = true) {
+#if defined(__linux__)
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+			error_code ec;
+			this->socket_.lowest_layer().set_option(asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>(usec), ec);
+			if (!ec && prefer)
+				this->socket_.lowest_layer().set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_PREFER_BUSY_POLL>(true), ec);
+			set_last_error(ec);
+			return !ec;
+#else
+			std::ignore = usec;
+			std::ignore = prefer;
+			set_last_error(asio::error::operation_not_supported);
 			return false;
+#endif
 		}
 
 		/**
@@ -205,61 +156,72 @@ namespace net {
 			if constexpr (!std::is_same_v<typename socket_type::protocol_type, asio::ip::tcp>) {
 				return false;
 			}
-			try {
-				std::ignore = count;
+			std::ignore = count;
 
-				auto & socket = this->socket_.lowest_layer();
-				if (!socket.is_open()) {
-					set_last_error(asio::error::not_connected);
-					return false;
-				}
+			auto & socket = this->socket_.lowest_layer();
+			if (!socket.is_open()) {
+				set_last_error(asio::error::not_connected);
+				return false;
+			}
 
-				this->keep_alive(onoff);
+			this->keep_alive(onoff);
 
-				auto native_fd = socket.native_handle();
+			auto native_fd = socket.native_handle();
 
 #if defined(__unix__) || defined(__linux__)
-				// For *n*x systems
-				int ret_keepidle = setsockopt(native_fd, SOL_TCP, TCP_KEEPIDLE, (void*)&idle, sizeof(unsigned int));
-				int ret_keepintvl = setsockopt(native_fd, SOL_TCP, TCP_KEEPINTVL, (void*)&interval, sizeof(unsigned int));
-				int ret_keepinit = setsockopt(native_fd, SOL_TCP, TCP_KEEPCNT, (void*)&count, sizeof(unsigned int));
+			// For *n*x systems
+			int ret_keepidle = setsockopt(native_fd, SOL_TCP, TCP_KEEPIDLE, (void*)&idle, sizeof(unsigned int));
+			int ret_keepintvl = setsockopt(native_fd, SOL_TCP, TCP_KEEPINTVL, (void*)&interval, sizeof(unsigned int));
+			int ret_keepinit = setsockopt(native_fd, SOL_TCP, TCP_KEEPCNT, (void*)&count, sizeof(unsigned int));
 
-				if (ret_keepidle || ret_keepintvl || ret_keepinit) {
-					set_last_error(errno);
-					return false;
-				}
+			if (ret_keepidle || ret_keepintvl || ret_keepinit) {
+				set_last_error(errno);
+				return false;
+			}
 #elif defined(__OSX__)
-				//// Set the timeout before the first keep alive message
-				//int ret_tcpkeepalive = setsockopt(native_fd, IPPROTO_TCP, TCP_KEEPALIVE, (void*)&idle, sizeof(unsigned int));
-				//int ret_tcpkeepintvl = setsockopt(native_fd, IPPROTO_TCP, TCP_CONNECTIONTIMEOUT, (void*)&interval, sizeof(unsigned int));
-
-				//if (ret_tcpkeepalive || ret_tcpkeepintvl) {
-				//	set_last_error(errno);
-				//	return false;
-				//}
+			//// Set the timeout before the first keep alive message
+			//int ret_tcpkeepalive = setsockopt(native_fd, IPPROTO_TCP, TCP_KEEPALIVE, (void*)&idle, sizeof(unsigned int));
+			//int ret_tcpkeepintvl = setsockopt(native_fd, IPPROTO_TCP, TCP_CONNECTIONTIMEOUT, (void*)&interval, sizeof(unsigned int));
+
+			//if (ret_tcpkeepalive || ret_tcpkeepintvl) {
+			//	set_last_error(errno);
+			//	return false;
+			//}
 #elif defined(_WIN32) || defined(_WIN64) || defined(_WINDOWS_) || defined(WIN32)
-				// Partially supported on windows
-				tcp_keepalive keepalive_options;
-				keepalive_options.onoff = onoff;
-				keepalive_options.keepalivetime = idle * 1000; // Keep Alive in milliseconds.
-				keepalive_options.keepaliveinterval = interval * 1000; // Resend if No-Reply 
-
-				DWORD bytes_returned = 0;
-
-				if (SOCKET_ERROR == ::WSAIoctl(native_fd, SIO_KEEPALIVE_VALS, (LPVOID)&keepalive_options, (DWORD)sizeof(keepalive_options),
-					nullptr, 0, (LPDWORD)&bytes_returned, nullptr, nullptr)) {
-					if (::WSAGetLastError() != WSAEWOULDBLOCK) {
-						set_last_error(::WSAGetLastError());
-						return false;
-					}
+			// Partially supported on windows
+			tcp_keepalive keepalive_options;
+			keepalive_options.onoff = onoff;
+			keepalive_options.keepalivetime = idle * 1000; // Keep Alive in milliseconds.
+			keepalive_options.keepaliveinterval = interval * 1000; // Resend if No-Reply 
+
+			DWORD bytes_returned = 0;
+
+			if (SOCKET_ERROR == ::WSAIoctl(native_fd, SIO_KEEPALIVE_VALS, (LPVOID)&keepalive_options, (DWORD)sizeof(keepalive_options),
+				nullptr, 0, (LPDWORD)&bytes_returned, nullptr, nullptr)) {
+				if (::WSAGetLastError() != WSAEWOULDBLOCK) {
+					set_last_error(::WSAGetLastError());
+					return false;
 				}
-#endif
-				return true;
 			}
-			catch (system_error & e) {
-				set_last_error(e);
-			}
-			return false;
+#endif
+			return true;
+		}
+
+	protected:
+		// 选项读写都用error_code重载, 失败记录到last_error, 不抛异常.
+		template<class Option>
+		inline bool set_option(const Option& option) {
+			error_code ec;
+			this->socket_.lowest_layer().set_option(option, ec);
+			set_last_error(ec);
+			return !ec;
+		}
+		template<class Option>
+		inline bool get_option(Option& option) const {
+			error_code ec;
+			this->socket_.lowest_layer().get_option(option, ec);
+			set_last_error(ec);
+			return !ec;
 		}
 
 	protected:
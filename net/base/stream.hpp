@@ -43,7 +43,7 @@ namespace net {
 
 		inline auto& stream() { return socket_type::stream(); }
 		inline auto& remote_endpoint() { return remote_endpoint_; }
-		inline void handle_recv(error_code ec, const std::string& s) {
+		inline void handle_recv(error_code ec, std::string&& s) {
 			//this->derive_.cbfunc()->call(Event::recv, this->derive_.self_shared_ptr(), std::move(s));
 			this->derive_.parse_proto(std::move(ec), std::move(s));
 		}
@@ -95,7 +95,7 @@ namespace net {
 		~StreamType() = default;
 
 		inline stream_type& stream() { return this->ssl_stream_; }
-		inline void handle_recv(error_code ec, const std::string& s) {
+		inline void handle_recv(error_code ec, std::string&& s) {
 			//this->derive_.cbfunc()->call(Event::recv, this->derive_.self_shared_ptr(), std::move(s));
 			this->derive_.parse_proto(std::move(ec), std::move(s));
 		}
@@ -119,16 +119,16 @@ namespace net {
 		inline void stream_post_handshake(std::shared_ptr<DRIVERTYPE> dptr, Fn&& fn) {
 			this->ssl_stream_.async_handshake(this->ssl_type_,
 				asio::bind_executor(this->ssl_io_.strand(),
-					[this, dptr = std::move(dptr), fn = std::move(fn)](const error_code& ec)
+					[this, dptr = std::move(dptr), fn = std::move(fn)](const error_code& ec) mutable
 			{
-				this->derive_.cbfunc()->call(Event::handshake, dptr, ec);
+				this->derive_.cbfunc()->template call<Event::handshake>(dptr, ec);
 				this->handle_handshake(ec, std::move(dptr), fn);
 			}));
 		}
 
 		template<typename Fn>
 		inline void handle_handshake(const error_code& ec, std::shared_ptr<DRIVERTYPE> dptr, Fn&& fn) {
-			asio::post(this->derive_.cio().strand(), [this, ec, dptr = std::move(dptr), fn = std::forward<Fn>(fn)]() mutable {
+			asio::post(this->derive_.io_executor(), [this, ec, dptr = std::move(dptr), fn = std::forward<Fn>(fn)]() mutable {
 				fn(ec);
 			});
 		}
@@ -164,34 +164,46 @@ namespace net {
 		~NetStream() {
 		}
 
-		inline void set_cert(const std::string& password, std::string_view certificate, std::string_view key, std::string_view dh) {
+		inline bool set_cert(const std::string& password, std::string_view certificate, std::string_view key, std::string_view dh) {
 			this->set_password_callback([password]
 			(std::size_t max_length, asio::ssl::context_base::password_purpose purpose) -> std::string {
 				return password;
 			});
 
-			this->use_certificate_chain(asio::buffer(certificate));
-			this->use_private_key(asio::buffer(key), asio::ssl::context::pem);
-			this->use_tmp_dh(asio::buffer(dh));
+			error_code ec;
+			this->use_certificate_chain(asio::buffer(certificate), ec);
+			if (!ec) this->use_private_key(asio::buffer(key), asio::ssl::context::pem, ec);
+			if (!ec) this->use_tmp_dh(asio::buffer(dh), ec);
+			set_last_error(ec);
+			return !ec;
 		}
 
-		inline void set_cert_file(const std::string& password, const std::string& certificate, const std::string& key, const std::string& dh) {
+		inline bool set_cert_file(const std::string& password, const std::string& certificate, const std::string& key, const std::string& dh) {
 			this->set_password_callback([password]
 			(std::size_t max_length, asio::ssl::context_base::password_purpose purpose) -> std::string {
 				return password;
 			});
 
-			this->use_certificate_chain_file(certificate);
-			this->use_private_key_file(key, asio::ssl::context::pem);
-			this->use_tmp_dh_file(dh);
+			error_code ec;
+			this->use_certificate_chain_file(certificate, ec);
+			if (!ec) this->use_private_key_file(key, asio::ssl::context::pem, ec);
+			if (!ec) this->use_tmp_dh_file(dh, ec);
+			set_last_error(ec);
+			return !ec;
 		}
 
-		inline void set_cert(std::string_view cert) {
-			this->add_certificate_authority(asio::buffer(cert));
+		inline bool set_cert(std::string_view cert) {
+			error_code ec;
+			this->add_certificate_authority(asio::buffer(cert), ec);
+			set_last_error(ec);
+			return !ec;
 		}
 
-		inline void set_cert_file(const std::string& file) {
-			this->load_verify_file(file);
+		inline bool set_cert_file(const std::string& file) {
+			error_code ec;
+			this->load_verify_file(file, ec);
+			set_last_error(ec);
+			return !ec;
 		}
 	};
 #endif
@@ -285,6 +297,7 @@ namespace net {
 		 * default mode : ikcp_nodelay(kcp, 0, 10, 0, 0);
 		 * generic mode : ikcp_nodelay(kcp, 0, 10, 0, 1);
 		 * fast    mode : ikcp_nodelay(kcp, 1, 10, 2, 1);
+		 * 实际参数由TRAITS::kcp指定, 默认为fast mode
 		 */
 		inline void stream_start(std::shared_ptr<DRIVERTYPE> dptr, std::uint32_t conv) {
 			if (this->kcp_) {
@@ -295,8 +308,9 @@ namespace net {
 			this->kcp_ = kcp::ikcp_create(conv, (void*)this);
 			this->kcp_->output = &stream_type::kcp_output;
 
-			kcp::ikcp_nodelay(this->kcp_, 1, 10, 2, 1);
-			kcp::ikcp_wndsize(this->kcp_, 128, 512);
+			using kcp_traits = typename DRIVERTYPE::traits_type::kcp;
+			kcp::ikcp_nodelay(this->kcp_, kcp_traits::nodelay, kcp_traits::interval, kcp_traits::resend, kcp_traits::nc);
+			kcp::ikcp_wndsize(this->kcp_, kcp_traits::sndwnd, kcp_traits::rcvwnd);
 
 			this->post_kcp_timer(std::move(dptr));
 		}
@@ -339,107 +353,94 @@ namespace net {
 
 		template<typename Fn>
 		inline void stream_post_handshake(std::shared_ptr<DRIVERTYPE> dptr, Fn && fn) {
-			try {
-				error_code ec;
-				if constexpr (is_svr_v<SVRORCLI>) {
-					// step 3 : server recvd syn from client (the first_pack_ is the syn)
-					// Check whether the first_pack_ packet is SYN handshake
-					if (!kcp::is_kcphdr_syn(dptr->get_first_pack())) {
-						this->handle_handshake(asio::error::no_protocol_option, std::move(dptr));
-						return;
-					}
-
-					// step 4 : server send synack to client
-					kcp::kcphdr* hdr = (kcp::kcphdr*)(dptr->get_first_pack().data());
-					const auto& key = dptr->hash_key();
-					std::uint32_t conv = std::fnv1a_hash<std::uint32_t>(
-						(const unsigned char* const)&key, std::uint32_t(sizeof(key)));
-					this->seq_ = conv;
-					kcp::kcphdr synack = kcp::make_kcphdr_synack(this->seq_, hdr->th_seq);
-					this->derive_.kcp_send_hdr(synack, ec);
-					asio::detail::throw_error(ec);
-
-					this->stream_start(dptr, this->seq_);
-					this->handle_handshake(ec, dptr);
-					fn(ec_ignore);
+			error_code ec;
+			if constexpr (is_svr_v<SVRORCLI>) {
+				// step 3 : server recvd syn from client (the first_pack_ is the syn)
+				// Check whether the first_pack_ packet is SYN handshake
+				if (!kcp::is_kcphdr_syn(dptr->get_first_pack())) {
+					this->handle_handshake(asio::error::no_protocol_option, std::move(dptr));
+					return;
 				}
-				else {
-					// step 1 : client send syn to server
-					this->seq_ = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
-						std::chrono::system_clock::now().time_since_epoch()).count());
-					kcp::kcphdr syn = kcp::make_kcphdr_syn(this->seq_);
-					this->derive_.kcp_send_hdr(syn, ec);
-					asio::detail::throw_error(ec);
-
-					kcp_timer_.post_timer(500, [this, syn](const error_code& ec) mutable {
-						if (ec == asio::error::operation_aborted)
-							return false;
-						this->derive_.kcp_send_hdr(syn, ec);
-						if (ec) {
-							set_last_error(ec);
-							derive_.stop(ec);
-							return false;
-						}
-						return true;
-					});
-
-					// step 2 : client wait for recv synack util connect timeout or recvd some data
-					derive_.stream().async_receive(asio::mutable_buffer(this->derive_.ubuffer().wr_buf(), this->derive_.ubuffer().wr_size()),
-						asio::bind_executor(kcp_io_.strand(), [this, this_ptr = std::move(dptr), fn = std::move(fn)]
-						(const error_code& ec, std::size_t bytes_recvd) mutable {
-						try {
-							kcp_timer_.stop();
-						}
-						catch (system_error&) {}
-						catch (std::exception&) {}
-
-						if (ec) {
-							this->handle_handshake(ec, std::move(this_ptr));
-							return;
-						}
-
-						this->derive_.ubuffer().wr_flip(bytes_recvd);
-
-						std::string s(static_cast<std::string::const_pointer>
-							(this->derive_.ubuffer().rd_buf()), bytes_recvd);
-						this->derive_.ubuffer().rd_flip(bytes_recvd);
-
-						// Check whether the data is the correct handshake information
-						if (kcp::is_kcphdr_synack(s, this->seq_)) {
-							std::uint32_t conv = ((kcp::kcphdr*)(s.data()))->th_seq;
-							this->stream_start(this_ptr, conv);
-							this->handle_handshake(ec, std::move(this_ptr));
-							fn(ec_ignore);
-						}
-						else {
-							this->handle_handshake(asio::error::no_protocol_option, std::move(this_ptr));
-						}
-					}));
+
+				// step 4 : server send synack to client
+				kcp::kcphdr* hdr = (kcp::kcphdr*)(dptr->get_first_pack().data());
+				const auto& key = dptr->hash_key();
+				std::uint32_t conv = std::fnv1a_hash<std::uint32_t>(
+					(const unsigned char* const)&key, std::uint32_t(sizeof(key)));
+				this->seq_ = conv;
+				kcp::kcphdr synack = kcp::make_kcphdr_synack(this->seq_, hdr->th_seq);
+				this->derive_.kcp_send_hdr(synack, ec);
+				if (ec) {
+					set_last_error(ec);
+					derive_.stop(ec);
+					return;
 				}
+
+				this->stream_start(dptr, this->seq_);
+				this->handle_handshake(ec, dptr);
+				fn(ec_ignore);
 			}
-			catch (system_error& e) {
-				set_last_error(e);
-				derive_.stop(e.code());
+			else {
+				// step 1 : client send syn to server
+				this->seq_ = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count());
+				kcp::kcphdr syn = kcp::make_kcphdr_syn(this->seq_);
+				this->derive_.kcp_send_hdr(syn, ec);
+				if (ec) {
+					set_last_error(ec);
+					derive_.stop(ec);
+					return;
+				}
+
+				kcp_timer_.post_timer(500, [this, syn](const error_code& ec) mutable {
+					if (ec == asio::error::operation_aborted)
+						return false;
+					this->derive_.kcp_send_hdr(syn, ec);
+					if (ec) {
+						set_last_error(ec);
+						derive_.stop(ec);
+						return false;
+					}
+					return true;
+				});
+
+				// step 2 : client wait for recv synack util connect timeout or recvd some data
+				derive_.stream().async_receive(asio::mutable_buffer(this->derive_.ubuffer().wr_buf(), this->derive_.ubuffer().wr_size()),
+					asio::bind_executor(kcp_io_.strand(), [this, this_ptr = std::move(dptr), fn = std::move(fn)]
+					(const error_code& ec, std::size_t bytes_recvd) mutable {
+					kcp_timer_.stop();
+
+					if (ec) {
+						this->handle_handshake(ec, std::move(this_ptr));
+						return;
+					}
+
+					this->derive_.ubuffer().wr_flip(bytes_recvd);
+
+					std::string s(static_cast<std::string::const_pointer>
+						(this->derive_.ubuffer().rd_buf()), bytes_recvd);
+					this->derive_.ubuffer().rd_flip(bytes_recvd);
+
+					// Check whether the data is the correct handshake information
+					if (kcp::is_kcphdr_synack(s, this->seq_)) {
+						std::uint32_t conv = ((kcp::kcphdr*)(s.data()))->th_seq;
+						this->stream_start(this_ptr, conv);
+						this->handle_handshake(ec, std::move(this_ptr));
+						fn(ec_ignore);
+					}
+					else {
+						this->handle_handshake(asio::error::no_protocol_option, std::move(this_ptr));
+					}
+				}));
 			}
 		}
 
 		inline void handle_handshake(const error_code& ec, std::shared_ptr<DRIVERTYPE> dptr) {
 			set_last_error(ec);
-			try {
-				if constexpr (is_svr_v<SVRORCLI>) {
-					this->derive_.cbfunc()->call(Event::handshake, dptr, ec);
-
-					asio::detail::throw_error(ec);
-
-					//this->derive_.handle_recv(ec, std::move(dptr->get_first_pack()));
-				}
-				else {
-					this->derive_.cbfunc()->call(Event::handshake, dptr, ec);
-				}
-			}
-			catch (system_error& e) {
-				set_last_error(e);
-				derive_.stop(e.code());
+			this->derive_.cbfunc()->template call<Event::handshake>(dptr, ec);
+			if constexpr (is_svr_v<SVRORCLI>) {
+				if (ec)
+					derive_.stop(ec);
 			}
 		}
 
@@ -67,11 +67,8 @@ namespace net {
 
 		inline void stop() {
 			this->timer_canceled_.test_and_set();
-			try {
-				this->timer_.cancel();
-			}
-			catch (system_error&) {}
-			catch (std::exception&) {}
+			// 只有底层取消失败才会报错, 不会发生在io_context的定时器队列上
+			this->timer_.cancel();
 		}
 
 	protected:
@@ -0,0 +1,162 @@
+#pragma once
+
+/*
+* 时间轮: 每个io线程(NIO)一个, 只用一个steady_timer驱动, 有定时项时才按tick运转.
+* 定时项(TimerWheel::node)嵌在使用者对象里, 调度/取消只是链表操作, 不分配内存.
+* 只能在所属io线程上调度/取消/回调; 调度时可以传入owner(一般是session的shared_ptr), 到期或取消之前保证对象存活.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <asio/steady_timer.hpp>
+
+namespace net {
+	class TimerWheel {
+	public:
+		class node {
+		public:
+			node() = default;
+			node(const node&) = delete;
+			node& operator=(const node&) = delete;
+			~node() { this->unlink(); }
+
+			// 到期回调, 设置一次即可
+			template<class Fn>
+			inline void callback(Fn&& fn) { this->fn_ = std::forward<Fn>(fn); }
+			inline bool linked() const { return this->prev_ != nullptr; }
+
+		private:
+			friend class TimerWheel;
+			inline void unlink() {
+				if (!this->prev_)
+					return;
+				this->prev_->next_ = this->next_;
+				if (this->next_)
+					this->next_->prev_ = this->prev_;
+				this->prev_ = this->next_ = nullptr;
+			}
+
+			node* prev_ = nullptr;
+			node* next_ = nullptr;
+			std::uint64_t expire_ = 0;		// 到期的tick
+			std::shared_ptr<void> owner_;
+			std::function<void()> fn_;
+		};
+
+		explicit TimerWheel(asio::io_context& io, std::chrono::milliseconds tick = std::chrono::milliseconds(100), std::size_t slots = 512)
+			: timer_(io)
+			, tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1))
+			, slots_(round_up(slots))
+			, epoch_(std::chrono::steady_clock::now()) {
+		}
+
+		~TimerWheel() {
+			this->timer_.cancel();
+			for (auto& head : this->slots_) {
+				while (node* n = head.next_) {
+					n->unlink();
+					auto owner = std::move(n->owner_);	// owner析构时可能销毁n
+				}
+			}
+		}
+
+		// 毫秒, 精度为tick; 时间轮运转时每个tick更新一次, 适合在收发路径上记录活跃时间
+		inline std::int64_t now() const {
+			return static_cast<std::int64_t>(this->current_ * this->tick_.count());
+		}
+
+		// delay毫秒后回调n, 已经在轮上的先取消
+		inline void schedule(node& n, std::int64_t delay, std::shared_ptr<void> owner = nullptr) {
+			this->cancel(n);
+			if (!this->running_)
+				this->current_ = this->clock_tick();
+			std::uint64_t ticks = delay <= 0 ? 1 : static_cast<std::uint64_t>((delay + this->tick_.count() - 1) / this->tick_.count());
+			n.expire_ = this->current_ + ticks;
+			n.owner_ = std::move(owner);
+			node& head = this->slots_[n.expire_ & (this->slots_.size() - 1)];
+			n.prev_ = &head;
+			n.next_ = head.next_;
+			if (head.next_)
+				head.next_->prev_ = &n;
+			head.next_ = &n;
+			++this->count_;
+			this->arm();
+		}
+
+		inline void cancel(node& n) {
+			if (!n.linked())
+				return;
+			n.unlink();
+			--this->count_;
+			auto owner = std::move(n.owner_);
+		}
+
+		inline std::size_t size() const { return this->count_; }
+
+	private:
+		static inline std::size_t round_up(std::size_t n) {
+			std::size_t size = 1;
+			while (size < n)
+				size <<= 1;
+			return size;
+		}
+
+		inline std::uint64_t clock_tick() const {
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - this->epoch_).count() / this->tick_.count());
+		}
+
+		inline void arm() {
+			if (this->running_ || this->count_ == 0)
+				return;
+			this->running_ = true;
+			this->timer_.expires_at(this->epoch_ + this->tick_ * (this->current_ + 1));
+			this->timer_.async_wait([this](const asio::error_code& ec) {
+				if (ec) {
+					this->running_ = false;
+					return;
+				}
+				// 回调里的schedule看到running_为true, 不会重新对齐current_
+				this->advance();
+				this->running_ = false;
+				this->arm();
+			});
+		}
+
+		// 处理到当前时间为止的所有tick; 落后时逐个追上, 不丢到期项
+		inline void advance() {
+			std::uint64_t target = this->clock_tick();
+			while (this->current_ < target && this->count_ > 0) {
+				++this->current_;
+				node& head = this->slots_[this->current_ & (this->slots_.size() - 1)];
+				// 回调可能调度/取消同一个槽里的其他项, 每次从头找到期项
+				for (;;) {
+					node* n = head.next_;
+					while (n && n->expire_ > this->current_)
+						n = n->next_;
+					if (!n)
+						break;
+					n->unlink();
+					--this->count_;
+					auto owner = std::move(n->owner_);
+					if (n->fn_)
+						n->fn_();
+				}
+			}
+			if (this->current_ < target)
+				this->current_ = target;
+		}
+
+		asio::steady_timer timer_;
+		std::chrono::milliseconds tick_;
+		std::vector<node> slots_;			// 每个槽一个哨兵节点
+		std::chrono::steady_clock::time_point epoch_;
+		std::uint64_t current_ = 0;
+		std::size_t count_ = 0;
+		bool running_ = false;
+	};
+}
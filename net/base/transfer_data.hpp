@@ -1,11 +1,14 @@
 #pragma once
 
+#include <array>
+#include <string_view>
+
 #include "base/iopool.hpp"
 #include "base/error.hpp"
 #include "tool/bytebuffer.hpp"
 
 namespace net {
-	template<class DRIVERTYPE, class SOCKETTYPE, class STREAMTYPE, class PROTOCOLTYPE, class SVRORCLI = svr_tab>
+	template<class DRIVERTYPE, class SOCKETTYPE, class STREAMTYPE, class PROTOCOLTYPE, class SVRORCLI = svr_tab, class TRAITS = default_traits>
 	class TransferData {
 	public:
 		TransferData(std::size_t max_buffer_size) 
@@ -17,22 +20,126 @@ namespace net {
 		template<class DATATYPE>
 		inline bool send(DATATYPE&& data) {
 			if constexpr (!std::is_void_v<PROTOCOLTYPE>) {
-				if (!this->derive_.pack_proto(std::forward<DATATYPE>(data))) {
+				proto_head head;
+				auto guard = this->derive_.pack_guard();
+				if (!this->derive_.pack_proto(std::forward<DATATYPE>(data), head)) {
 					return false;
 				}
+				if (!head.body.empty()) {
+					return this->send_packed(head, std::move(head.body));
+				}
+				if (head.size > 0) {
+					return this->send_packed(head, std::forward<DATATYPE>(data));
+				}
+			}
+			return this->send_packed(std::forward<DATATYPE>(data));
+		}
+
+		// 协议头单独生成时, tcp上把{head, data}聚合写出; udp上拼成一个包
+		template<class DATATYPE>
+		inline bool send_packed(const proto_head& head, DATATYPE&& data) {
+			if constexpr (is_tcp_socket_v<SOCKETTYPE>) {
+				std::string payload(std::forward<DATATYPE>(data));
+				std::size_t size = head.size + payload.size();
+				if (!this->send_check(payload, head.size))
+					return false;
+				bool ret = this->send_enqueue([this, head, data = std::move(payload)]() mutable {
+					std::array<asio::const_buffer, 2> buffers{ asio::buffer(head.data, head.size), asio::buffer(data) };
+					return this->do_send<SOCKETTYPE>(buffers, [](const error_code&, std::size_t) {});
+				});
+				if (ret)
+					this->derive_.stats_send(size);
+				return ret;
 			}
+			else {
+				std::string_view payload(data);
+				std::string packet;
+				packet.reserve(head.size + payload.size());
+				packet.append(head.data, head.size).append(payload);
+				return this->send_packed(std::move(packet));
+			}
+		}
+
+		// 发送已经按协议打包好的数据(如websocket控制帧), 不再经过pack_proto
+		template<class DATATYPE>
+		inline bool send_packed(DATATYPE&& data) {
+			std::size_t size = 0;
+			if constexpr (TRAITS::stats)
+				size = std::string_view(data).size();
+			bool ret = false;
 			if constexpr (is_tcp_socket_v<SOCKETTYPE>) { // tcp
-				return this->send_t(std::move(data));
+				ret = this->send_t(std::string(std::forward<DATATYPE>(data)));
 			}
 			else if constexpr (is_udp_socket_v<SOCKETTYPE>) { //udp
 				if constexpr (is_cli_v<SVRORCLI>) {
-					return this->send_t(std::move(data));
+					ret = this->send_t(std::string(std::forward<DATATYPE>(data)));
 				}
 				else {
-					return this->send_t(derive_.remote_endpoint(), std::move(data));
+					ret = this->send_t(derive_.remote_endpoint(), std::string(std::forward<DATATYPE>(data)));
+				}
+			}
+			if (ret)
+				this->derive_.stats_send(size);
+			return ret;
+		}
+
+		// 插队发送已经打包好的小数据(如websocket的ping/pong): io线程上有分段发送进行中时插在两段之间, 否则和send_packed一样排队
+		inline bool send_urgent(std::string&& data) {
+			if constexpr (is_tcp_socket_v<SOCKETTYPE>) {
+				if (this->chunked_.load(std::memory_order_relaxed) > 0 && this->derive_.io_executor().running_in_this_thread()) {
+					if (!this->send_check(data))
+						return false;
+					this->derive_.stats_send(data.size());
+					this->urgent_queue_.emplace(std::move(data));
+					return true;
 				}
 			}
-			return false;
+			return this->send_packed(std::move(data));
+		}
+
+		// 发送最后一段已经打包好的数据(如websocket关闭握手的回复), 排在已入队的数据之后, 写完后以ec停止session
+		inline bool send_last(std::string&& data, const error_code& ec) {
+			if constexpr (is_tcp_socket_v<SOCKETTYPE>) {
+				if (!this->send_check(data))
+					return false;
+				std::size_t size = data.size();
+				bool ret = this->send_enqueue([this, ec, data = std::move(data)]() mutable {
+					return this->do_send<SOCKETTYPE>(data, [this, ec](const error_code& e, std::size_t) {
+						if (!e)
+							this->derive_.stop(ec);
+					});
+				});
+				if (ret)
+					this->derive_.stats_send(size);
+				return ret;
+			}
+			else {
+				bool ret = this->send_packed(std::move(data));
+				this->derive_.stop(ec);
+				return ret;
+			}
+		}
+
+		// 分段发送(tcp): next(chunk)在io线程里按需生成下一段, 返回false表示结束, chunk在下一次调用之前有效.
+		// 整个过程在发送队列里只占一个位置, 之后send的数据等所有段写完; 同时只有一段数据在内存里.
+		template<class Producer>
+		inline bool send_chunked(Producer&& next) {
+			static_assert(is_tcp_socket_v<SOCKETTYPE>, "send_chunked needs a tcp socket");
+			if (!this->derive_.is_started()) {
+				set_last_error(asio::error::not_connected);
+				return false;
+			}
+			this->chunked_.fetch_add(1, std::memory_order_relaxed);
+			bool ret = this->send_enqueue([this, next = std::make_shared<chunk_producer>(std::forward<Producer>(next))]() {
+				// 不在入队的调用栈里开始, 避免第一段就结束时在队首任务里出队
+				asio::post(this->derive_.io_executor(), [this, p = this->derive_.self_shared_ptr(), next]() mutable {
+					this->chunk_resume(std::move(next));
+				});
+				return true;
+			});
+			if (!ret)
+				this->chunked_.fetch_sub(1, std::memory_order_relaxed);
+			return ret;
 		}
 
 		inline void do_recv() {
@@ -40,57 +147,89 @@ namespace net {
 		}
 
 	protected:
-		inline bool send_t(const std::string&& data) {
-			try {
-				if (!this->derive_.is_started())
-					asio::detail::throw_error(asio::error::not_connected);
-				if (data.length() <= 0)
-					asio::detail::throw_error(asio::error::invalid_argument);
-
-				return this->send_enqueue([this,
-					data = std::move(data)]() mutable {
-					return this->do_send<SOCKETTYPE>(data, [](const error_code&, std::size_t) {});
-				});
+		using chunk_producer = std::function<bool(std::string_view&)>;
+
+		// 写出下一段; 先写插队的数据
+		inline void chunk_resume(std::shared_ptr<chunk_producer>&& next) {
+			if (!this->urgent_queue_.empty()) {
+				auto data = std::make_shared<std::string>(std::move(this->urgent_queue_.front()));
+				this->urgent_queue_.pop();
+				asio::async_write(this->derive_.stream(), asio::buffer(*data), asio::bind_executor(this->derive_.io_executor(),
+					[this, p = this->derive_.self_shared_ptr(), data, next = std::move(next)](const error_code& ec, std::size_t) mutable {
+					this->chunk_written(ec, std::move(next));
+				}));
+				return;
+			}
+			std::string_view chunk;
+			if (!this->derive_.is_started() || !(*next)(chunk)) {
+				this->chunked_.fetch_sub(1, std::memory_order_relaxed);
+				this->urgent_clear();
+				this->send_dequeue();
+				return;
 			}
-			catch (system_error& e) { set_last_error(e); }
-			catch (std::exception&) { set_last_error(asio::error::eof); }
-			return false;
+			this->derive_.stats_send(chunk.size());
+			asio::async_write(this->derive_.stream(), asio::buffer(chunk.data(), chunk.size()), asio::bind_executor(this->derive_.io_executor(),
+				[this, p = this->derive_.self_shared_ptr(), next = std::move(next)](const error_code& ec, std::size_t) mutable {
+				this->chunk_written(ec, std::move(next));
+			}));
 		}
 
-		template<class Endpoint, typename = std::enable_if_t<std::is_same_v<unqualified_t<Endpoint>, asio::ip::udp::endpoint>>>
-		inline bool send_t(Endpoint&& endpoint, const std::string&& data) {
-			try {
-				if (!this->derive_.is_started())
-					asio::detail::throw_error(asio::error::not_connected);
-				if (data.length() <= 0)
-					asio::detail::throw_error(asio::error::invalid_argument);
-
-				return this->send_enqueue([this,
-					endpoint = std::forward<Endpoint>(endpoint),
-					data = std::move(data)]() mutable {
-					return this->do_send(endpoint, data, [](const error_code&, std::size_t) {});
-				});
+		inline void chunk_written(const error_code& ec, std::shared_ptr<chunk_producer>&& next) {
+			set_last_error(ec);
+			if (ec) {
+				this->chunked_.fetch_sub(1, std::memory_order_relaxed);
+				this->urgent_clear();
+				this->derive_.stop(ec);
+				this->send_dequeue();
+				return;
 			}
-			catch (system_error& e) { set_last_error(e); }
-			catch (std::exception&) { set_last_error(asio::error::eof); }
-			
-			return false;
+			this->chunk_resume(std::move(next));
+		}
+
+		// 丢弃插队的数据: 分段发送失败或者session停止后不能留到下一个连接上发送, 在io线程调用
+		inline void urgent_clear() {
+			std::queue<std::string>().swap(this->urgent_queue_);
+		}
+
+		// data已经是调用方传入数据的副本(右值时为移动), 直接移进发送队列
+		inline bool send_t(std::string&& data) {
+			if (!this->send_check(data))
+				return false;
+			return this->send_enqueue([this,
+				data = std::move(data)]() mutable {
+				return this->do_send<SOCKETTYPE>(data, [](const error_code&, std::size_t) {});
+			});
+		}
+
+		template<class Endpoint, typename = std::enable_if_t<std::is_same_v<unqualified_t<Endpoint>, asio::ip::udp::endpoint>>>
+		inline bool send_t(Endpoint&& endpoint, std::string&& data) {
+			if (!this->send_check(data))
+				return false;
+			return this->send_enqueue([this,
+				endpoint = std::forward<Endpoint>(endpoint),
+				data = std::move(data)]() mutable {
+				return this->do_send(endpoint, data, [](const error_code&, std::size_t) {});
+			});
 		}
 
 		inline bool send_t(std::string&& host, std::string&& port, const std::string&& data) {
-			try {
-				if (!this->derive_.is_started())
-					asio::detail::throw_error(asio::error::not_connected);
-				if (data.length() <= 0)
-					asio::detail::throw_error(asio::error::invalid_argument);
+			if (!this->send_check(data))
+				return false;
+			return this->do_resolve_send(std::forward<std::string>(host), std::forward<std::string>(port),
+				std::move(data), [](const error_code&, std::size_t) {});
+		}
 
-				return this->do_resolve_send(std::forward<std::string>(host), std::forward<std::string>(port),
-					std::move(data), [](const error_code&, std::size_t) {});
+		// head_size: 单独发送的协议头长度, 只有协议头的包(如空的websocket消息)是合法的
+		inline bool send_check(const std::string& data, std::size_t head_size = 0) {
+			if (!this->derive_.is_started()) {
+				set_last_error(asio::error::not_connected);
+				return false;
 			}
-			catch (system_error& e) { set_last_error(e); }
-			catch (std::exception&) { set_last_error(asio::error::eof); }
-
-			return false;
+			if (head_size + data.length() == 0) {
+				set_last_error(asio::error::invalid_argument);
+				return false;
+			}
+			return true;
 		}
 
 	protected:
@@ -105,29 +244,25 @@ namespace net {
 		inline void do_recv_t() {
 			if (!this->derive_.is_started())
 				return;
-			try {
-				asio::async_read(this->derive_.stream(), this->buffer_, asio::transfer_at_least(1),
-					asio::bind_executor(derive_.cio().strand(),
-						[this, selfptr = this->derive_.self_shared_ptr()](const error_code& ec, std::size_t bytes_recvd)
-				{
-					set_last_error(ec);
-					if (!ec) {
-						this->derive_.handle_recv(ec, std::string(reinterpret_cast<
-							std::string::const_pointer>(this->buffer_.data().data()), bytes_recvd));
+			asio::async_read(this->derive_.stream(), this->buffer_, asio::transfer_at_least(1),
+				asio::bind_executor(this->derive_.io_executor(),
+					[this, selfptr = this->derive_.self_shared_ptr()](const error_code& ec, std::size_t bytes_recvd)
+			{
+				set_last_error(ec);
+				if (!ec) {
+					this->derive_.handle_recv(ec, std::string(reinterpret_cast<
+						std::string::const_pointer>(this->buffer_.data().data()), bytes_recvd));
 
-						this->buffer_.consume(bytes_recvd);
+					this->buffer_.consume(bytes_recvd);
 
-						this->do_recv_t<TSOCKETTYPE>();
-					}
-					else {
-						this->derive_.stop(ec);
-					}
-				}));
-			}
-			catch (system_error& e) {
-				set_last_error(e);
-				this->derive_.stop(e.code());
-			}
+					if (this->derive_.recv_paused())	// 事件环满, 暂存的事件压入后恢复读取
+						return;
+					this->do_recv_t<TSOCKETTYPE>();
+				}
+				else {
+					this->derive_.stop(ec);
+				}
+			}));
 		}
 		/*
 		desc: udp recv data
@@ -139,29 +274,25 @@ namespace net {
 			}
 			if (!this->derive_.is_started())
 				return;
-			try {
-				this->ubuffer_.wr_reserve(init_buffer_size_);
-				this->derive_.stream().async_receive(asio::mutable_buffer(this->ubuffer_.wr_buf(), this->ubuffer_.wr_size()),
-					asio::bind_executor(derive_.cio().strand(), 
-						[this, selfptr = this->derive_.self_shared_ptr()](const error_code& ec, std::size_t bytes_recvd)
-				{
-					if (ec == asio::error::operation_aborted) {
-						this->derive_.stop(ec);
-						return;
-					}
-					this->ubuffer_.wr_flip(bytes_recvd);
-					this->derive_.handle_recv(ec, std::string(reinterpret_cast<
-						std::string::const_pointer>(this->ubuffer_.rd_buf()), bytes_recvd));
+			this->ubuffer_.wr_reserve(init_buffer_size_);
+			this->derive_.stream().async_receive(asio::mutable_buffer(this->ubuffer_.wr_buf(), this->ubuffer_.wr_size()),
+				asio::bind_executor(this->derive_.io_executor(), 
+					[this, selfptr = this->derive_.self_shared_ptr()](const error_code& ec, std::size_t bytes_recvd)
+			{
+				if (ec == asio::error::operation_aborted) {
+					this->derive_.stop(ec);
+					return;
+				}
+				this->ubuffer_.wr_flip(bytes_recvd);
+				this->derive_.handle_recv(ec, std::string(reinterpret_cast<
+					std::string::const_pointer>(this->ubuffer_.rd_buf()), bytes_recvd));
 
-					this->ubuffer_.reset();
+				this->ubuffer_.reset();
 
-					this->do_recv_t<USOCKETTYPE>();
-				}));
-			}
-			catch (system_error& e) {
-				set_last_error(e);
-				this->derive_.stop(e.code());
-			}
+				if (this->derive_.recv_paused())
+					return;
+				this->do_recv_t<USOCKETTYPE>();
+			}));
 			/*asio::post(this->derive_.cio().strand(), [this]()
 			{
 				
@@ -171,10 +302,18 @@ namespace net {
 		/*
 		desc: send data
 		*/
+		// 已经是buffer序列(聚合写)时原样使用, 否则按连续内存处理
+		template<class Data>
+		static inline auto send_buffers(Data& data) {
+			if constexpr (asio::is_const_buffer_sequence<unqualified_t<Data>>::value)
+				return data;
+			else
+				return asio::buffer(data);
+		}
 		template<class TSOCKETTYPE, bool IsAsync = true, class Data, class Callback, std::enable_if_t<is_tcp_socket_v<TSOCKETTYPE>, bool> = true>
 		inline bool do_send(Data&& buffer, Callback&& callback) {
 			if constexpr (IsAsync) {
-				asio::async_write(this->derive_.stream(), asio::buffer(buffer), asio::bind_executor(this->derive_.cio().strand(),
+				asio::async_write(this->derive_.stream(), send_buffers(buffer), asio::bind_executor(this->derive_.io_executor(),
 					[this, p = this->derive_.self_shared_ptr(), callback = std::forward<Callback>(callback)]
 				(const error_code& ec, std::size_t bytes_sent) mutable {
 					set_last_error(ec);
@@ -188,7 +327,7 @@ namespace net {
 			}
 			else {
 				error_code ec;
-				std::size_t bytes_sent = asio::write(this->derive_.stream(), buffer, ec);
+				std::size_t bytes_sent = asio::write(this->derive_.stream(), send_buffers(buffer), ec);
 				set_last_error(ec);
 				callback(ec, bytes_sent);
 				if (ec) {
@@ -204,7 +343,7 @@ namespace net {
 				return kcp_do_send(data, callback);
 			}
 			if constexpr (IsAsync) {
-				this->derive_.stream().async_send(asio::buffer(std::forward<Data>(data)), asio::bind_executor(this->derive_.cio().strand(),
+				this->derive_.stream().async_send(asio::buffer(std::forward<Data>(data)), asio::bind_executor(this->derive_.io_executor(),
 					[this, p = this->derive_.self_shared_ptr(), callback = std::forward<Callback>(callback)]
 				(const error_code& ec, std::size_t bytes_sent) mutable {
 					set_last_error(ec);
@@ -229,7 +368,7 @@ namespace net {
 				return kcp_do_send(data, callback);
 			}
 			if constexpr (IsAsync) {
-				this->derive_.stream().async_send_to(asio::buffer(data), endpoint, asio::bind_executor(this->derive_.cio().strand(),
+				this->derive_.stream().async_send_to(asio::buffer(data), endpoint, asio::bind_executor(this->derive_.io_executor(),
 					[this, p = this->derive_.self_shared_ptr(), callback = std::forward<Callback>(callback)]
 				(const error_code& ec, std::size_t bytes_sent) mutable {
 					set_last_error(ec);
@@ -257,7 +396,7 @@ namespace net {
 
 			resolver_type* resolver_pointer = resolver_ptr.get();
 			resolver_pointer->async_resolve(std::forward<std::string>(host), std::forward<std::string>(port),
-				asio::bind_executor(this->derive_.cio().strand(),
+				asio::bind_executor(this->derive_.io_executor(),
 					[this, p = this->derive_.self_shared_ptr(), resolver_ptr = std::move(resolver_ptr),
 					data = std::forward<Data>(data), callback = std::forward<Callback>(callback)]
 			(const error_code& ec, const endpoints_type& endpoints) mutable {
@@ -298,7 +437,7 @@ namespace net {
 			callback(get_last_error(), ret < 0 ? 0 : buffer.size());
 
 			if constexpr (IsAsync) {
-				this->send_queue_.pop();
+				this->send_queue_pop();
 			}
 
 			return (ret == 0);
@@ -327,22 +466,33 @@ namespace net {
 				return;
 			}
 			for (;;) {
-				len = kcp::ikcp_recv(pkcp, (char*)ubuffer_.wr_buf(), ubuffer_.wr_size());
-				if (len >= 0) {
-					ubuffer_.wr_flip(len);
-					/*this->derive_.handle_recv(ec_ignore, std::string(reinterpret_cast<
-						std::string::const_pointer>(ubuffer_.rd_buf()), len));*/
-					/*this->derive_.cbfunc()->call(Event::recv, this->derive_.self_shared_ptr(), std::string(reinterpret_cast<
-						std::string::const_pointer>(ubuffer_.rd_buf()), len));*/
-					this->derive_.parse_proto(ec_ignore, std::string(reinterpret_cast<
-						std::string::const_pointer>(ubuffer_.rd_buf()), len));
-
-					ubuffer_.rd_flip(len);
-				}
-				else if (len == -3) {
-					ubuffer_.wr_reserve(init_buffer_size_);
+				// 按整条消息的长度一次预留好缓存, 不再按-3逐次扩容重试
+				int size = kcp::ikcp_peeksize(pkcp);
+				if (size < 0)
+					break;
+				ubuffer_.wr_reserve(static_cast<unsigned int>(size));
+				len = kcp::ikcp_recv(pkcp, (char*)ubuffer_.wr_buf(), (int)ubuffer_.wr_size());
+				if (len < 0)
+					break;
+				ubuffer_.wr_flip(len);
+				if constexpr (TRAITS::stream_recv_size > 0) {
+					// kcp消息受接收窗口限制(不超过IKCP_WND_RCV个分片), 整条收到后作为一段派发, 不再拷贝
+					if (static_cast<std::size_t>(len) >= TRAITS::stream_recv_size) {
+						this->derive_.stream_begin(static_cast<std::uint64_t>(len));
+						this->derive_.stream_chunk(std::string_view(reinterpret_cast<const char*>(ubuffer_.rd_buf()), len));
+						this->derive_.stream_end();
+						ubuffer_.rd_flip(len);
+						continue;
+					}
 				}
-				else break;
+				/*this->derive_.handle_recv(ec_ignore, std::string(reinterpret_cast<
+					std::string::const_pointer>(ubuffer_.rd_buf()), len));*/
+				/*this->derive_.cbfunc()->call(Event::recv, this->derive_.self_shared_ptr(), std::string(reinterpret_cast<
+					std::string::const_pointer>(ubuffer_.rd_buf()), len));*/
+				this->derive_.parse_proto(ec_ignore, std::string(reinterpret_cast<
+					std::string::const_pointer>(ubuffer_.rd_buf()), len));
+
+				ubuffer_.rd_flip(len);
 			}
 			kcp::ikcp_flush(pkcp);
 		}
@@ -398,7 +548,14 @@ namespace net {
 		template<bool IsAsync = true, class Callback>
 		inline bool send_enqueue(Callback&& f) {
 			if constexpr (IsAsync) {
-				if (this->derive_.cio().strand().running_in_this_thread()) {
+				if constexpr (TRAITS::send_queue_size > 0) {
+					if (this->queue_size_.fetch_add(1, std::memory_order_relaxed) >= TRAITS::send_queue_size) {
+						this->queue_size_.fetch_sub(1, std::memory_order_relaxed);
+						set_last_error(asio::error::no_buffer_space);
+						return false;
+					}
+				}
+				if (this->derive_.io_executor().running_in_this_thread()) {
 					bool empty = this->send_queue_.empty();
 					this->send_queue_.emplace(std::forward<Callback>(f));
 					if (empty) {
@@ -406,7 +563,7 @@ namespace net {
 					}
 					return true;
 				}
-				asio::post(this->derive_.cio().strand(),
+				asio::post(this->derive_.io_executor(),
 					[this, p = this->derive_.self_shared_ptr(), f = std::forward<Callback>(f)]() mutable {
 					bool empty = this->send_queue_.empty();
 					this->send_queue_.emplace(std::move(f));
@@ -417,10 +574,10 @@ namespace net {
 				return true;
 			}
 			else {
-				if (this->derive_.cio().strand().running_in_this_thread()) {
+				if (this->derive_.io_executor().running_in_this_thread()) {
 					return f();
 				}
-				asio::post(this->derive_.cio().strand(),
+				asio::post(this->derive_.io_executor(),
 					[this, p = this->derive_.self_shared_ptr(), f = std::forward<Callback>(f)]() mutable
 				{
 					f();
@@ -430,14 +587,19 @@ namespace net {
 		}
 		//非线程安全
 		inline void send_dequeue() {
-			NET_ASSERT(this->derive_.cio().strand().running_in_this_thread());
+			NET_ASSERT(this->derive_.io_executor().running_in_this_thread());
 			if (!this->send_queue_.empty()) {
-				this->send_queue_.pop();
+				this->send_queue_pop();
 				if (!this->send_queue_.empty()) {
 					(this->send_queue_.front())();
 				}
 			}
 		}
+		inline void send_queue_pop() {
+			this->send_queue_.pop();
+			if constexpr (TRAITS::send_queue_size > 0)
+				this->queue_size_.fetch_sub(1, std::memory_order_relaxed);
+		}
 
 	protected:
 		DRIVERTYPE& derive_;
@@ -445,8 +607,14 @@ namespace net {
 
 		asio::streambuf buffer_;
 
-		t_buffer_cmdqueue<> ubuffer_;
-		std::size_t init_buffer_size_ = 1024;
+		traits_stream_buffer_t<TRAITS> ubuffer_;
+		static constexpr std::size_t init_buffer_size_ = TRAITS::udp_buffer_size;
+
+		// 发送队列长度, 只在设置了send_queue_size时使用
+		std::atomic<std::size_t> queue_size_{ 0 };
+		// 排队和进行中的分段发送数; 插队的数据只在io线程访问
+		std::atomic<std::size_t> chunked_{ 0 };
+		std::queue<std::string> urgent_queue_;
 	};
 }
 
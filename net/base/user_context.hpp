@@ -0,0 +1,55 @@
+#pragma once
+
+#include <any>
+#include <type_traits>
+#include <utility>
+
+namespace net {
+	// session上的用户数据, 类型由TRAITS::user_context_type指定：
+	//	void	沿用std::any, 可以存放任意类型
+	//	T		直接内嵌在session对象中, context()取引用, 无需any_cast和堆分配; 断开时重置为T{}
+	template<class T>
+	class UserContext {
+	public:
+		static_assert(std::is_default_constructible_v<T>, "user_context_type must be default constructible");
+
+		inline T& context() { return this->user_context_; }
+		inline const T& context() const { return this->user_context_; }
+
+		template<class DataT>
+		inline void user_data(DataT&& data) {
+			this->user_context_ = std::forward<DataT>(data);
+		}
+		template<class DataT>
+		inline DataT* user_data() {
+			static_assert(std::is_same_v<DataT, T>, "user_data type must be user_context_type");
+			return &this->user_context_;
+		}
+		inline void user_data_reset() {
+			this->user_context_ = T{};
+		}
+
+	protected:
+		T user_context_{};
+	};
+
+	template<>
+	class UserContext<void> {
+	public:
+		template<class DataT>
+		inline void user_data(DataT&& data) {
+			this->user_data_ = std::forward<DataT>(data);
+		}
+		template<class DataT>
+		inline DataT* user_data() {
+			// 指针版本的any_cast类型不符时返回nullptr, 不抛异常
+			return std::any_cast<DataT>(&this->user_data_);
+		}
+		inline void user_data_reset() {
+			this->user_data_.reset();
+		}
+
+	protected:
+		std::any user_data_;
+	};
+}
@@ -39,12 +39,12 @@ using KcpCli = net::Client<asio::ip::udp::socket, net::kcp_stream_flag>;
 
 //websocket
 using WebsocketSvr = net::Server<asio::ip::tcp::socket, net::binary_stream_flag, net::websocket_proto_flag>;
-//using WebsocketCli = net::Client<asio::ip::tcp::socket, net::binary_stream_flag, net::websocket_proto_flag>;
+using WebsocketCli = net::Client<asio::ip::tcp::socket, net::binary_stream_flag, net::websocket_proto_flag>;
 
 //websockets
 #if defined(NET_USE_SSL)
 using WebsocketsSvr = net::Server<asio::ip::tcp::socket, net::ssl_stream_flag, net::websocket_proto_flag>;
-//using WebsocketsCli = net::Client<asio::ip::tcp::socket, net::ssl_stream_flag, net::websocket_proto_flag>;
+using WebsocketsCli = net::Client<asio::ip::tcp::socket, net::ssl_stream_flag, net::websocket_proto_flag>;
 #endif
 
 //下面得都有待实现
@@ -24,16 +24,22 @@
 */
 
 
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <random>
+#include <string_view>
 //#include <inttypes.h>
-#include "opt/common/sha1.hpp"
-#include "opt/common/base64.hpp"
-#include "opt/common/md5.hpp"
+#include "base/error.hpp"
+#include "opt/websocket/ws_mask.hpp"
+#include "opt/websocket/ws_deflate.hpp"
+#include "opt/websocket/ws_handshake.hpp"
+#include "opt/websocket/ws_utf8.hpp"
 #include "tool/bytebuffer.hpp"
+#include "tool/mirror_buffer.hpp"
+#include "tool/logger.hpp"
 
 namespace net {
-#define MAGIC_KEY "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
-typedef std::unordered_map<std::string, std::string> HEADER_MAP;
 
 	struct WebSocketMark {
 		std::uint8_t fin : 1;
@@ -66,14 +72,30 @@ typedef std::unordered_map<std::string, std::string> HEADER_MAP;
 			headlength = 0;
 		}
 		
+		// 每帧都会调用, 只在NET_LOG_LEVEL为trace时编译进来
 		inline void log() {
-			std::cout << "===============================接收到的协议包头相关信息=====================================" << std::endl;
-			std::cout << "fin: " << (int)this->mark.fin << "\nrsv1: " << (int)this->mark.rsv1 << "\nrsv2: " << (int)this->mark.rsv2 << "\nrsv3: " << (int)this->mark.rsv3
-				<< "\nopcode: " << (int)this->mark.opcode << "\nmask: " << (int)this->mark.mask << "\nmask_key: " << (int*)this->maskkey << "\npayloadlen: " << (int)this->mark.payloadlen
-				<< "\nheadlength: " << this->headlength << "\nreallength: " << this->reallength << std::endl;
+			NET_LOG_TRACE("websocket header fin:{} rsv1:{} rsv2:{} rsv3:{} opcode:{} mask:{} payloadlen:{} headlength:{} reallength:{}",
+				+this->mark.fin, +this->mark.rsv1, +this->mark.rsv2, +this->mark.rsv3, +this->mark.opcode, +this->mark.mask,
+				+this->mark.payloadlen, this->headlength, this->reallength);
 		}
 	};
 
+	enum class ws_opcode : std::uint8_t {
+		continuation = 0x0,
+		text = 0x1,
+		binary = 0x2,
+		close = 0x8,
+		ping = 0x9,
+		pong = 0xA,
+	};
+
+	// 流式接收: 一条消息依次为begin(总长度, 分片消息未知时为0), 若干chunk, end
+	enum class ws_stream_part : std::uint8_t {
+		begin,
+		chunk,
+		end,
+	};
+
 	struct ProtoEnv {
 		std::uint8_t fin = 1;
 		std::uint8_t opcode = 2;
@@ -83,310 +105,507 @@ typedef std::unordered_map<std::string, std::string> HEADER_MAP;
 		}
 	};
 
-	class WebSocket {
-	public:
-		WebSocket() = default;
-		~WebSocket() = default;
+	// BUFFER为接收缓存类型(t_buffer_cmdqueue或者t_mirror_cmdqueue)
+	template<class BUFFER = t_buffer_cmdqueue<>>
+	class basic_websocket {
 	public:
-		inline bool get_handshark_pack(std::string& response) {
-			std::string server_key;
+		static constexpr std::size_t max_head_size = 14;	//帧头最长14字节
 
-			HEADER_MAP::iterator itr = header_map_.find("Sec-WebSocket-Key1");
-			if (itr != header_map_.end()) {
-				auto ret = generate_key_safari(server_key);
-				if (!ret) {
-					return false;
-				}
-				const char* handshakeFormat = "HTTP/1.1 101 Web Socket Protocol Handshake\r\n"
-					"Upgrade: WebSocket\r\n"
-					"Connection: Upgrade\r\n"
-					"Sec-WebSocket-Origin: %s\r\n"
-					"Sec-WebSocket-Location: ws://%s%s\r\n"
-					"Sec-WebSocket-Protocol: %s\r\n\r\n";
-				sprintf(response.data(), handshakeFormat, header_map_["Origin"].c_str(), header_map_["Host"].c_str(), header_map_["GET"].c_str(), header_map_["Sec-WebSocket-Protocol"].c_str());
-				response.append(server_key);
-			}
-			else {
-				auto ret = generate_key_chrome(server_key);
-				if (!ret) {
-					return false;
+		basic_websocket() = default;
+		~basic_websocket() = default;
+	public:
+		// 处理升级请求: 完整时把响应写入resp, s只保留请求之后的数据(可能已经是帧), 返回true;
+		// 不完整时缓存已收到的部分并返回false, 请求非法时设置ec
+		inline bool handshake(std::string& s, ws_handshake_response& resp, error_code& ec) {
+			return this->feed_handshake(s, ec, [this, &resp](std::string_view data, error_code& ec) -> std::size_t {
+				ws_upgrade_request req;
+				std::size_t used = ws_parse_upgrade(data, req, ec);
+				if (used == 0)
+					return 0;
+				if (!this->pack_handshake(req, resp)) {
+					ec = req.key.empty() ? asio::error::invalid_argument : asio::error::message_size;
+					return 0;
 				}
-				response.append("HTTP/1.1 101 Switching Protocols\r\n""Upgrade: websocket\r\n");
-				response.append("Sec-WebSocket-Accept: " + server_key + "\r\n");
-				response.append("Connection: upgrade\r\n\r\n");
-			}
-			std::cout << "handshark response :" << response.c_str() << std::endl;
-			
-			return true;
+				NET_LOG_DEBUG("handshark response: {}", resp.view());
+				return used;
+			});
 		}
-		//生成key(chrome版本)
-		inline bool generate_key_chrome(std::string& key) {
-			key = header_map_["Sec-WebSocket-Key"];
-			if (key.empty()) {
+
+		// 客户端: 生成升级请求写入out, 之后发出的帧都带掩码
+		inline bool pack_upgrade_request(std::string_view host, std::string_view path, ws_handshake_response& out) {
+			this->client_ = true;
+			std::array<std::uint32_t, 4> random{ mask_random(), mask_random(), mask_random(), mask_random() };
+			unsigned char nonce[16];
+			std::memcpy(nonce, random.data(), sizeof(nonce));
+			char key[ws_client_key_size];
+			ws_client_key(nonce, key);
+			if (!ws_accept_key(std::string_view(key, sizeof(key)), this->accept_)) {
 				return false;
 			}
-			key.append(MAGIC_KEY);
-			unsigned char message_digest[20];
-			sha1::calc(key.c_str(), key.length(), message_digest);
-			key = base64_encode(message_digest, 20);
+			return out.append("GET ") && out.append(path.empty() ? std::string_view("/") : path)
+				&& out.append(" HTTP/1.1\r\nHost: ") && out.append(host)
+				&& out.append("\r\nUpgrade: websocket\r\n"
+					"Connection: Upgrade\r\n"
+					"Sec-WebSocket-Key: ") && out.append(std::string_view(key, sizeof(key)))
+				&& out.append("\r\nSec-WebSocket-Version: 13\r\n\r\n");
+		}
 
-			return true;
+		// 客户端: 处理升级响应, 返回值和s的处理同handshake; 状态码不是101时ec为connection_refused
+		inline bool handshake_response(std::string& s, error_code& ec) {
+			return this->feed_handshake(s, ec, [this](std::string_view data, error_code& ec) -> std::size_t {
+				ws_upgrade_response resp;
+				std::size_t used = ws_parse_upgrade_response(data, resp, ec);
+				if (used == 0)
+					return 0;
+				if (resp.status != 101)
+					ec = asio::error::connection_refused;
+				else if (!ws_handshake_detail::icontains(resp.upgrade, "websocket")
+					|| resp.accept != std::string_view(this->accept_, sizeof(this->accept_))
+					|| !resp.extensions.empty())		// 没有声明任何扩展
+					ec = asio::error::invalid_argument;
+				return ec ? 0 : used;
+			});
 		}
-		//生成key(safari版本), 该接口有待真实环境测试
-		inline bool generate_key_safari(std::string& key) {
-			std::string const& key1 = header_map_["Sec-WebSocket-Key1"];
-			std::string const& key2 = header_map_["Sec-WebSocket-Key2"];
-			std::string const& key3 = header_map_["Sec-WebSocket-Key3"];
-			if (key1.empty() || key2.empty() || key3.size() != 8) {
+
+		// 握手数据可能分多次到达: 不完整时缓存, 完整后s只保留握手之后的数据
+		template<class Fn>
+		inline bool feed_handshake(std::string& s, error_code& ec, Fn&& fn) {
+			std::string_view data = s;
+			if (!hs_buffer_.empty()) {
+				hs_buffer_.append(s);
+				data = hs_buffer_;
+			}
+			std::size_t used = fn(data, ec);
+			if (ec) {
+				std::string().swap(hs_buffer_);
 				return false;
 			}
-
-			char key_final[16];
-			decode_client_key(key1, &key_final[0]);
-			decode_client_key(key2, &key_final[4]);
-			std::copy(key3.c_str(),
-				key3.c_str() + (std::min)(static_cast<size_t>(8), key3.size()),
-				&key_final[8]);
-			key = md5::md5_hash_string(std::string(key_final, 16));
-
+			if (used == 0) {
+				if (hs_buffer_.empty())
+					hs_buffer_.assign(s);
+				return false;
+			}
+			if (hs_buffer_.empty()) {
+				s.erase(0, used);
+			}
+			else {
+				s.assign(hs_buffer_, used, std::string::npos);
+				std::string().swap(hs_buffer_);
+			}
 			return true;
 		}
-		inline void decode_client_key(std::string const& key, char* result) const {
-			unsigned int spaces = 0;
-			std::string digits;
-			std::uint32_t num;
 
-			for (size_t i = 0; i < key.size(); i++) {
-				if (key[i] == ' ') {
-					spaces++;
-				}
-				else if (key[i] >= '0' && key[i] <= '9') {
-					digits += key[i];
+		inline bool pack_handshake(const ws_upgrade_request& req, ws_handshake_response& resp) {
+			if (req.key.empty()) {
+				//hixie-76(老版本safari), 该分支有待真实环境测试
+				char answer[16];
+				if (!ws_hixie_answer(req, answer)) {
+					return false;
 				}
+				return resp.append("HTTP/1.1 101 Web Socket Protocol Handshake\r\n"
+					"Upgrade: WebSocket\r\n"
+					"Connection: Upgrade\r\n"
+					"Sec-WebSocket-Origin: ") && resp.append(req.origin)
+					&& resp.append("\r\nSec-WebSocket-Location: ws://") && resp.append(req.host) && resp.append(req.path)
+					&& resp.append("\r\nSec-WebSocket-Protocol: ") && resp.append(req.protocol)
+					&& resp.append("\r\n\r\n") && resp.append(std::string_view(answer, sizeof(answer)));
 			}
-
-			num = static_cast<std::uint32_t>(strtoul(digits.c_str(), NULL, 10));
-			if (spaces > 0 && num > 0) {
-				num = htonl(num / spaces);
-				std::copy(reinterpret_cast<char*>(&num),
-					reinterpret_cast<char*>(&num) + 4,
-					result);
+			char accept[ws_accept_key_size];
+			if (!ws_accept_key(req.key, accept)) {
+				return false;
 			}
-			else {
-				std::fill(result, result + 4, 0);
+			bool ok = resp.append("HTTP/1.1 101 Switching Protocols\r\n"
+				"Upgrade: websocket\r\n"
+				"Connection: Upgrade\r\n"
+				"Sec-WebSocket-Accept: ") && resp.append(std::string_view(accept, sizeof(accept))) && resp.append("\r\n");
+#if defined(NET_USE_ZLIB)
+			if (ok && this->deflate_enable_ && !req.extensions.empty()) {
+				std::string accepted = deflate_.negotiate(req.extensions);
+				if (!accepted.empty())
+					ok = resp.append("Sec-WebSocket-Extensions: ") && resp.append(accepted) && resp.append("\r\n");
 			}
+#endif
+			return ok && resp.append("\r\n");
 		}
 
-		inline int parse_http_info(const char* buff) {
-			header_map_.clear();
-			std::istringstream s(buff);
-			std::string request;
-
-			std::getline(s, request);
-			if (request[request.size() - 1] == '\r') {
-				request.erase(request.end() - 1);
-				std::string::size_type pos1;
-				std::string::size_type pos2;
-				pos1 = request.find("GET ", 0);
-				pos1 += sizeof("GET ") - 1;
-				pos2 = request.find(0x20, pos1);
-				pos2 = pos2 - sizeof(0x20);
-				std::string value = request.substr(pos1, pos2);
-				header_map_["GET"] = value;
+		// 解析一帧的帧头, 返回整帧长度(帧头+负载); 数据不足返回0, 协议错误时设置ec
+		inline std::size_t decode_header(const char* msg, std::size_t len, error_code& ec) {
+			if (len < 2) {
+				return 0;
 			}
-			else {
-				return -1;
+			std::uint8_t b0 = static_cast<std::uint8_t>(msg[0]);
+			std::uint8_t b1 = static_cast<std::uint8_t>(msg[1]);
+			std::uint8_t payloadlen = b1 & 0x7f;
+			std::size_t headlen = 2;
+			if (payloadlen == 126)
+				headlen += 2;
+			else if (payloadlen == 127)
+				headlen += 8;
+			if (b1 & 0x80)
+				headlen += 4;
+			if (len < headlen) {
+				return 0;
 			}
 
-			std::string header;
-			std::string::size_type end;
-
-			while (std::getline(s, header) && header != "\r") {
-				if (header[header.size() - 1] != '\r') {
-					continue; //end
-				}
-				else {
-					header.erase(header.end() - 1);	//remove last char
+			std::uint64_t reallength = payloadlen;
+			if (payloadlen >= 126) {
+				std::size_t n = (payloadlen == 126) ? 2 : 8;
+				reallength = 0;
+				for (std::size_t i = 0; i < n; ++i) {
+					reallength = (reallength << 8) | static_cast<std::uint8_t>(msg[2 + i]);
 				}
-
-				end = header.find(": ", 0);
-				if (end != std::string::npos) {
-					std::string key = header.substr(0, end);
-					std::string value = header.substr(end + 2);
-					header_map_[key] = value;
-				}
-			}
-
-			std::size_t src_len = strlen(buff);
-			if (src_len <= 8) {
-				return 0;
 			}
-			char key3[9] = {0}; // 获取 key3，即正文最后的8位字符
-			std::memcpy(key3, &buff[src_len - 8], 8);
-			header_map_["Sec-WebSocket-Key3"] = key3;
 
-			return 0;
-		}
-
-		inline bool analysis_msg(const char* ptCmd, const unsigned int nCmdLen) {
-			ws_header_.reset();
-			
-			int pos = 0;
-			fetch_base(ptCmd, pos);
-			fetch_hasmask(ptCmd, pos);
-			fetch_packagelength(ptCmd, pos);
-			fetch_maskkey(ptCmd, pos);
-			fetch_packagedata(ptCmd, pos);
+			ws_header_.mark.fin = b0 >> 7;
+			ws_header_.mark.rsv1 = (b0 >> 6) & 0x1;
+			ws_header_.mark.rsv2 = (b0 >> 5) & 0x1;
+			ws_header_.mark.rsv3 = (b0 >> 4) & 0x1;
+			ws_header_.mark.opcode = b0 & 0x0f;
+			ws_header_.mark.mask = b1 >> 7;
+			ws_header_.mark.payloadlen = payloadlen;
+			ws_header_.reallength = reallength;
+			ws_header_.headlength = static_cast<std::uint32_t>(headlen);
+			if (ws_header_.mark.mask)
+				std::memcpy(ws_header_.maskkey, msg + headlen - 4, 4);
+			else
+				std::memset(ws_header_.maskkey, 0, 4);
 
 			// log
 			ws_header_.log();
 
-			return check_unpack(nCmdLen);
-		}
-		inline int fetch_base(const char* msg, int& pos) {
-			ws_header_.mark.fin = ((unsigned char)msg[pos] >> 7);
-			ws_header_.mark.rsv1 = msg[pos] & 0x40;
-			ws_header_.mark.rsv2 = msg[pos] & 0x20;
-			ws_header_.mark.rsv3 = msg[pos] & 0x10;
-			ws_header_.mark.opcode = msg[pos] & 0x0f;
-			pos++;
-			return pos;
+			std::uint8_t opcode = ws_header_.mark.opcode;
+			bool control = (opcode & 0x8) != 0;
+			std::uint8_t rsv_allowed = 0;
+#if defined(NET_USE_ZLIB)
+			// 协商了permessage-deflate时, 消息的第一帧可以用rsv1标记压缩
+			if (deflate_.active() && (opcode == 0x1 || opcode == 0x2))
+				rsv_allowed = 0x40;
+#endif
+			if ((b0 & 0x70 & ~rsv_allowed) != 0 ||						// 没有协商扩展, rsv必须为0
+				(opcode > 0x2 && opcode < 0x8) || opcode > 0xA ||		// 保留的opcode
+				(control && (!ws_header_.mark.fin || reallength > 125))) {	// 控制帧不能分片, 负载不超过125
+				ec = asio::error::invalid_argument;
+				return 0;
+			}
+			if (reallength > this->max_message_size_ && !this->stream_frame()) {
+				ec = asio::error::message_size;
+				return 0;
+			}
+			return headlen + static_cast<std::size_t>(reallength);
 		}
-		inline int fetch_hasmask(const char* msg, int& pos) {
-			ws_header_.mark.mask = ((unsigned char)msg[pos] >> 7);
-			return pos;
+
+		inline void mask_payload(char* msg, std::size_t len) {
+			if (ws_header_.mark.mask == 0)
+				return;
+			ws_mask(msg, len, ws_header_.maskkey);
 		}
-		inline int fetch_packagelength(const char* msg, int& pos) {
-			ws_header_.mark.payloadlen = msg[pos] & 0x7f;
-			ws_header_.reallength = ws_header_.mark.payloadlen;
-			pos++;
-			if (ws_header_.mark.payloadlen == 126) {
-				std::uint16_t length = 0;
-				std::memcpy(&length, msg + pos, 2);
-				pos += 2;
-				ws_header_.reallength = ntohs(length);
-			}
-			else if (ws_header_.mark.payloadlen == 127) {
-				std::uint64_t length = 0;
-				std::memcpy(&length, msg + pos, 8);
-				pos += 8;
-				ws_header_.reallength = ntohl(length);
+
+		// 解析data中所有完整的帧, 返回消耗的字节数; 不完整的帧留到下次.
+		// 负载在原地解码, fn(opcode, data)中的data直接指向缓存, 回调返回后失效.
+		// 流式接收的帧不等收全, 收到多少交给sfn(ws_stream_part::chunk, 0, data)多少.
+		template<class Fn, class SFn>
+		inline std::size_t parse_frames(char* data, std::size_t len, Fn& fn, SFn& sfn, error_code& ec) {
+			std::size_t pos = 0;
+			this->pending_ = 0;
+			while (pos < len) {
+				if (this->stream_left_ > 0) {
+					std::size_t n = static_cast<std::size_t>((std::min)(static_cast<std::uint64_t>(len - pos), this->stream_left_));
+					if (!this->stream_payload(data + pos, n, sfn, ec))
+						break;
+					pos += n;
+					continue;
+				}
+				std::size_t framelen = this->decode_header(data + pos, len - pos, ec);
+				if (ec) {
+					break;
+				}
+				if (framelen > 0 && this->stream_frame()) {
+					pos += ws_header_.headlength;
+					this->stream_start(sfn);
+					std::size_t n = static_cast<std::size_t>((std::min)(static_cast<std::uint64_t>(len - pos), ws_header_.reallength));
+					if (!this->stream_payload(data + pos, n, sfn, ec))
+						break;
+					pos += n;
+					continue;
+				}
+				if (framelen == 0 || len - pos < framelen) {
+					// 帧头不完整或者负载未收全, 记下整帧长度以便提前预留缓存
+					this->pending_ = framelen;
+					break;
+				}
+				char* payload = data + pos + ws_header_.headlength;
+				std::size_t paylen = static_cast<std::size_t>(ws_header_.reallength);
+				this->mask_payload(payload, paylen);
+				pos += framelen;
+
+				auto opcode = static_cast<ws_opcode>(ws_header_.mark.opcode);
+				if (ws_header_.mark.opcode & 0x8) {
+					// 控制帧可以插在分片消息中间; 关闭原因必须是UTF-8
+					if (opcode == ws_opcode::close && paylen > 2 && this->validate_utf8_ && !ws_utf8_valid(payload + 2, paylen - 2)) {
+						this->utf8_error(ec);
+						break;
+					}
+					fn(opcode, std::string_view(payload, paylen));
+					if (opcode == ws_opcode::close) {
+						this->reset();
+						return len;
+					}
+					continue;
+				}
+				if (opcode == ws_opcode::continuation) {
+					if (this->frag_opcode_ == ws_opcode::continuation) {
+						ec = asio::error::invalid_argument;
+						break;
+					}
+					if (this->frag_.size() + paylen > this->max_message_size_) {
+						ec = asio::error::message_size;
+						break;
+					}
+					if (!this->feed_utf8(payload, paylen, ws_header_.mark.fin, ec))
+						break;
+					this->frag_.append(payload, paylen);
+					if (ws_header_.mark.fin) {
+						opcode = this->frag_opcode_;
+						this->frag_opcode_ = ws_opcode::continuation;
+						bool ok = this->deliver(fn, opcode, std::string_view(this->frag_), this->frag_compressed_, ec, true);
+						this->frag_.clear();
+						if (!ok)
+							break;
+					}
+					continue;
+				}
+				if (this->frag_opcode_ != ws_opcode::continuation) {
+					// 上一条分片消息还没有结束
+					ec = asio::error::invalid_argument;
+					break;
+				}
+				if (!ws_header_.mark.fin) {
+					this->frag_opcode_ = opcode;
+					this->frag_compressed_ = ws_header_.mark.rsv1;
+					// 未压缩的文本分片逐片校验, 不等整条消息收齐
+					if (!this->feed_utf8(payload, paylen, false, ec))
+						break;
+					this->frag_.assign(payload, paylen);
+					continue;
+				}
+				if (!this->deliver(fn, opcode, std::string_view(payload, paylen), ws_header_.mark.rsv1, ec))
+					break;
 			}
 			return pos;
 		}
-		inline int fetch_maskkey(const char* msg, int& pos) {
-			if (ws_header_.mark.mask == 0)
-				return 0;
-			std::memcpy(ws_header_.maskkey, &msg[pos], 4);
-			pos += 4;
-			return 0;
+
+		// 当前帧是否流式接收: 开启了流式接收的未压缩数据帧, 新消息不小于stream_size,
+		// 或者缓存中的分片消息加上这一片达到stream_size(之后整条消息都流式接收)
+		inline bool stream_frame() const {
+			if (this->stream_size_ == 0 || (ws_header_.mark.opcode & 0x8) || ws_header_.mark.rsv1)
+				return false;
+			if (ws_header_.mark.opcode == 0) {
+				if (this->streaming_)
+					return true;
+				return this->frag_opcode_ != ws_opcode::continuation && !this->frag_compressed_ &&
+					this->frag_.size() + ws_header_.reallength >= this->stream_size_;
+			}
+			return !this->streaming_ && this->frag_opcode_ == ws_opcode::continuation && ws_header_.reallength >= this->stream_size_;
 		}
-		inline int fetch_packagedata(const char* msg, int& pos) {
-			std::ignore = msg;
-			ws_header_.headlength = pos;
-			pos += ws_header_.reallength;
-			return 0;
+
+		template<class SFn>
+		inline void stream_start(SFn& sfn) {
+			this->stream_left_ = ws_header_.reallength;
+			this->stream_phase_ = 0;
+			if (this->streaming_)
+				return;
+			this->streaming_ = true;
+			if (ws_header_.mark.opcode == 0) {
+				// 已经缓存的分片先交出去(UTF-8已经逐片校验过)
+				sfn(ws_stream_part::begin, 0, std::string_view());
+				if (!this->frag_.empty())
+					sfn(ws_stream_part::chunk, 0, std::string_view(this->frag_));
+				this->frag_.clear();
+				return;
+			}
+			this->frag_opcode_ = static_cast<ws_opcode>(ws_header_.mark.opcode);
+			this->frag_compressed_ = false;
+			this->msg_opcode_ = ws_header_.mark.opcode;
+			sfn(ws_stream_part::begin, ws_header_.mark.fin ? ws_header_.reallength : 0, std::string_view());
 		}
 
-		inline bool mask_dec(char* msg, std::uint64_t len) {
-			if (len != ws_header_.reallength) {
+		// 流式接收的帧负载, 可能只是一部分
+		template<class SFn>
+		inline bool stream_payload(char* payload, std::size_t n, SFn& sfn, error_code& ec) {
+			if (ws_header_.mark.mask)
+				this->stream_phase_ = ws_mask(payload, n, ws_header_.maskkey, this->stream_phase_);
+			this->stream_left_ -= n;
+			bool fin = this->stream_left_ == 0 && ws_header_.mark.fin;
+			if (!this->feed_utf8(payload, n, fin, ec))
 				return false;
-			}
-			if (ws_header_.mark.mask != 0) {
-				for (std::uint64_t i = 0; i < len; i++) {
-					std::uint64_t j = i % 4;
-					msg[i] = msg[i] ^ ws_header_.maskkey[j];
-				}
+			if (n > 0)
+				sfn(ws_stream_part::chunk, 0, std::string_view(payload, n));
+			if (fin) {
+				this->streaming_ = false;
+				this->frag_opcode_ = ws_opcode::continuation;
+				sfn(ws_stream_part::end, 0, std::string_view());
 			}
 			return true;
 		}
 
-		inline bool check_unpack(unsigned int buffLen) {
-			constexpr std::size_t marklen = sizeof(WebSocketMark);
-			unsigned int headLen = 0;
-			if (buffLen < marklen) {
+		// 分片消息的一片; 只处理未压缩的文本消息, 压缩的在解压后整体校验
+		inline bool feed_utf8(const char* payload, std::size_t paylen, bool fin, error_code& ec) {
+			if (!this->validate_utf8_ || this->frag_opcode_ != ws_opcode::text || this->frag_compressed_)
+				return true;
+			if (this->utf8_.feed(payload, paylen) && (!fin || this->utf8_.finish()))
+				return true;
+			this->utf8_.reset();
+			this->utf8_error(ec);
+			return false;
+		}
+
+		inline void utf8_error(error_code& ec) {
+			NET_LOG_WARN("websocket text is not valid utf-8");
+			ec.assign(EILSEQ, asio::error::get_system_category());
+		}
+
+		// 派发一条完整的数据消息, 压缩过的先解压; checked: 文本已经逐片校验过
+		template<class Fn>
+		inline bool deliver(Fn& fn, ws_opcode opcode, std::string_view payload, bool compressed, error_code& ec, bool checked = false) {
+#if defined(NET_USE_ZLIB)
+			if (compressed) {
+				if (!deflate_.decompress(payload, this->inflate_buf_, this->max_message_size_)) {
+					ec = (this->inflate_buf_.size() >= this->max_message_size_) ? asio::error::message_size : asio::error::invalid_argument;
+					return false;
+				}
+				payload = this->inflate_buf_;
+			}
+#else
+			std::ignore = compressed;
+#endif
+			if (opcode == ws_opcode::text && this->validate_utf8_ && (compressed || !checked) && !ws_utf8_valid(payload)) {
+				this->utf8_error(ec);
 				return false;
 			}
-			if (ws_header_.mark.payloadlen < 126) {
-				headLen = marklen;
+			this->msg_opcode_ = static_cast<std::uint8_t>(opcode);
+			fn(opcode, payload);
+			return true;
+		}
+
+		// 生成帧头写入out(至少14字节), 返回帧头长度; maskkey不为空时带掩码
+		static inline std::size_t pack_header(char* out, std::uint64_t len, std::uint8_t fin, std::uint8_t opcode, const std::uint8_t* maskkey) {
+			std::size_t headLen = 2;
+			out[0] = static_cast<char>((fin << 7) | (0xF & opcode));
+			out[1] = static_cast<char>(maskkey ? 0x80 : 0);
+			if (len < 126) {// 不需要扩展长度位, 两个字节存放 fin(1bit) + rsv[3](1bit) + opcode(4bit); mask(1bit) + payloadLength(7bit);
+				out[1] |= static_cast<char>(len);
 			}
-			else if (ws_header_.mark.payloadlen == 126) {
-				headLen = marklen + 2;
+			else if (len <= 0xFFFF) {// 后面的两个字节(16bit)表示长度
+				out[1] |= 0x7E;
+				out[2] = static_cast<char>(len >> 8);
+				out[3] = static_cast<char>(len);
+				headLen += 2;
 			}
-			else if (ws_header_.mark.payloadlen == 127) {
-				headLen = marklen + 8;
+			else {// 后面的8个字节(64bit)表示长度
+				out[1] |= 0x7F;
+				for (int i = 0; i < 8; ++i) {
+					out[2 + i] = static_cast<char>(len >> (56 - 8 * i));
+				}
+				headLen += 8;
 			}
-			if (ws_header_.mark.mask == 1) {
+			if (maskkey) {
+				std::memcpy(out + headLen, maskkey, 4);
 				headLen += 4;
 			}
-			if (buffLen < headLen) {
-				return false;
-			}
-
-			auto packLen = ws_header_.headlength + ws_header_.reallength;
-			if (buffLen < packLen) {
-				return false;
-			}
-
-			return true;
+			return headLen;
 		}
 
 		inline int pack_data(const std::string& message, std::string& outstr, std::uint8_t fin, std::uint8_t opcode, std::uint8_t mask) {
-			int headLen = 0;
 			std::size_t msgLen = message.length();
 			if (msgLen <= 0) {
 				return 0;
 			}
-
-			auto slen = msgLen;
-			if (msgLen < 126) // 如果不需要扩展长度位, 两个字节存放 fin(1bit) + rsv[3](1bit) + opcode(4bit); mask(1bit) + payloadLength(7bit);  
-				slen += 2;
-			else if (msgLen < 0xFFFF) // 如果数据长度超过126 并且小于两个字节, 我们再用后面的两个字节(16bit) 表示 uint16  
-				slen += 4;
-			else // 如果数据更长的话, 我们使用后面的8个字节(64bit)表示 uint64  
-				slen += 10;
-			
-			if (mask & 0x1)
-				slen += 4;
-		
-			outstr.resize(slen);
-			char* out = outstr.data();
-			//memset(out, 0, slen);
-			*out = fin << 7;
-			*out = *out | (0xF & opcode);
-			*(out + 1) = mask << 7;
-			if (msgLen < 126) {
-				*(out + 1) = *(out + 1) | msgLen;
-				headLen += 2;
+			std::uint8_t maskkey[4];
+			if (mask & 0x1) {
+				// 客户端发送的帧必须带随机掩码
+				std::uint32_t key = mask_random();
+				std::memcpy(maskkey, &key, 4);
 			}
-			else if (msgLen < 0xFFFF) {
-				*(out + 1) = *(out + 1) | 0x7E; 
-				std::uint16_t* tmp = (uint16_t*)(out + 2);
-				*tmp = htons((std::uint16_t)msgLen);
-				headLen += 4;
+			char head[14];
+			std::size_t headLen = pack_header(head, msgLen, fin, opcode, (mask & 0x1) ? maskkey : nullptr);
+			outstr.resize(headLen + msgLen);
+			char* out = outstr.data();
+			std::memcpy(out, head, headLen);
+			std::memcpy(out + headLen, message.data(), msgLen);
+			if (mask & 0x1) {
+				ws_mask(out + headLen, msgLen, maskkey);
 			}
-			else {
-				*(out + 1) = *(out + 1) | 0x7F;
-				std::uint64_t* tmp = (uint64_t*)(out + 2);
-				*tmp = htonl((std::uint64_t)msgLen);
-				headLen += 10;
+			return static_cast<int>(headLen + msgLen);
+		}
+
+		static inline std::uint32_t mask_random() {
+			thread_local std::minstd_rand gen(std::random_device{}());
+			return static_cast<std::uint32_t>(gen()) ^ (static_cast<std::uint32_t>(gen()) << 16);
+		}
+
+		// 不带掩码时只生成帧头, 负载由调用方和帧头一起聚合写出, 不拷贝; 需要掩码时返回false
+		template<class HEAD>
+		inline bool get_pack_head(std::size_t len, HEAD& head, bool compressed = false) {
+			if ((penv_.mask & 0x1) || this->client_) {
+				return false;
 			}
-			if (mask & 0x1) {
-				std::memcpy(out + headLen, "0101", 4);
-				/*for(UINT64 i = 0; i < msgLen; i++){
-					int j = i % 4;
-					message[i] = message[i] ^ *send[headLen+i];
-				}*/
-				headLen += 4;
+			head.size = static_cast<std::uint8_t>(pack_header(head.data, len, penv_.fin, this->msg_opcode_, nullptr));
+			if (compressed)
+				head.data[0] |= 0x40;	// rsv1: permessage-deflate
+			penv_.reset();
+			return true;
+		}
+
+		// 分片发送: 负载已经放在buf + max_head_size处, 帧头写在它前面, 返回整帧; 客户端原地掩码
+		inline std::string_view pack_fragment(char* buf, std::size_t len, ws_opcode opcode, bool fin) {
+			char head[max_head_size];
+			std::uint8_t maskkey[4];
+			if (this->client_) {
+				std::uint32_t key = mask_random();
+				std::memcpy(maskkey, &key, 4);
+				ws_mask(buf + max_head_size, len, maskkey);
 			}
-			std::memcpy((out)+headLen, message.c_str(), msgLen);
-			*(out + slen) = '\0';
-			return slen;
+			std::size_t headlen = pack_header(head, len, fin ? 1 : 0, static_cast<std::uint8_t>(opcode), this->client_ ? maskkey : nullptr);
+			char* start = buf + max_head_size - headlen;
+			std::memcpy(start, head, headlen);
+			return std::string_view(start, headlen + len);
+		}
+
+		// 需要掩码时(客户端), 帧头写入head, 负载拷贝到head.body后原地掩码
+		template<class HEAD>
+		inline void get_pack_masked(std::string_view data, HEAD& head) {
+			std::uint8_t maskkey[4];
+			std::uint32_t key = mask_random();
+			std::memcpy(maskkey, &key, 4);
+			head.size = static_cast<std::uint8_t>(pack_header(head.data, data.size(), penv_.fin, this->msg_opcode_, maskkey));
+			head.body.assign(data.data(), data.size());
+			ws_mask(head.body.data(), head.body.size(), maskkey);
+			penv_.reset();
+		}
+
+		// 协商了permessage-deflate且消息不小于min_size时压缩到out, 返回false表示原样发送
+		inline bool compress_message(std::string_view data, std::string& out) {
+#if defined(NET_USE_ZLIB)
+			if (deflate_.active() && data.size() >= deflate_.min_size() && !(penv_.mask & 0x1))
+				return deflate_.compress(data, out);
+#else
+			std::ignore = data;
+			std::ignore = out;
+#endif
+			return false;
+		}
+
+#if defined(NET_USE_ZLIB)
+		inline void deflate_options(const ws_deflate_options& opts) {
+			this->deflate_enable_ = true;
+			deflate_.options(opts);
 		}
+		inline ws_deflate& deflate() { return deflate_; }
+#endif
 
 		inline int get_pack_data(const std::string& message, std::string& outstr) {
-			penv_.opcode = ws_header_.mark.opcode;
-			std::size_t nPackLen = pack_data(message, outstr, penv_.fin, penv_.opcode, penv_.mask);
+			penv_.opcode = this->msg_opcode_;
+			std::size_t nPackLen = pack_data(message, outstr, penv_.fin, penv_.opcode, penv_.mask | (this->client_ ? 1 : 0));
 			penv_.reset();
 			if (nPackLen <= 0) {
 				return -2;
@@ -394,57 +613,127 @@ typedef std::unordered_map<std::string, std::string> HEADER_MAP;
 			return nPackLen;
 		}
 
+		// 控制帧(close/ping/pong), 负载不超过125字节, 服务端发送不加掩码, 客户端加掩码
+		inline std::string pack_control(ws_opcode opcode, std::string_view payload) {
+			std::size_t len = (std::min)(payload.size(), static_cast<std::size_t>(125));
+			std::uint8_t maskkey[4];
+			if (this->client_) {
+				std::uint32_t key = mask_random();
+				std::memcpy(maskkey, &key, 4);
+			}
+			char head[14];
+			std::size_t headlen = pack_header(head, len, 1, static_cast<std::uint8_t>(opcode), this->client_ ? maskkey : nullptr);
+			std::string out(headlen + len, '\0');
+			std::memcpy(out.data(), head, headlen);
+			std::memcpy(out.data() + headlen, payload.data(), len);
+			if (this->client_)
+				ws_mask(out.data() + headlen, len, maskkey);
+			return out;
+		}
+
 		inline ProtoEnv* get_pack_env() { return &penv_; }
 		inline WebSocketHeader* get_proto_heard() { return &ws_header_; }
 
+		inline void max_message_size(std::size_t size) { this->max_message_size_ = size; }
+		inline std::size_t max_message_size() const { return this->max_message_size_; }
+
+		// 不小于size的消息按begin/chunk/end流式交给parse的sfn, 不受max_message_size限制; 0关闭. 压缩的消息不流式接收
+		inline void stream_size(std::size_t size) { this->stream_size_ = size; }
+		inline std::size_t stream_size() const { return this->stream_size_; }
+
+		// 是否校验文本消息和关闭原因是UTF-8, 可信的内部连接可以关闭
+		inline void validate_utf8(bool enable) { this->validate_utf8_ = enable; }
+		inline bool validate_utf8() const { return this->validate_utf8_; }
+
+		// 解析本次读到的数据, 每个完整的帧(分片消息在最后一片)调用一次fn(ws_opcode, std::string_view).
+		// 协议错误或者消息超过max_message_size时返回错误, 调用方应断开连接.
+		// 设置了stream_size时, 大消息改为调用sfn(ws_stream_part, 总长度, data).
 		template<class Fn>
-		inline void parse(const std::string& s, Fn&& fn) {
-			auto slen = s.length();
-			if (slen <= 0) {
-				return;
+		inline error_code parse(std::string& s, Fn&& fn) {
+			return this->parse(s, std::forward<Fn>(fn), [](ws_stream_part, std::uint64_t, std::string_view) {});
+		}
+		template<class Fn, class SFn>
+		inline error_code parse(std::string& s, Fn&& fn, SFn&& sfn) {
+			error_code ec;
+			if (s.empty()) {
+				return ec;
 			}
-			rcv_buffer_.put(s.data(), slen);
-			do {
-				if (rcv_buffer_.rd_ready()) {
-					bool ret = analysis_msg(rcv_buffer_.rd_buf(), rcv_buffer_.rd_size());
-					if (!ret) {
-						break;
-					}
-					if (rcv_buffer_.rd_size() >= (ws_header_.headlength + ws_header_.reallength)) {
-						std::string sdata(reinterpret_cast<
-							std::string::const_pointer>(&rcv_buffer_.rd_buf()[ws_header_.headlength]), ws_header_.reallength);
-						if (this->mask_dec(sdata.data(), sdata.length())) {
-							fn(ws_header_.mark.opcode, sdata);
-							rcv_buffer_.rd_flip(ws_header_.headlength + ws_header_.reallength);
-						}
-					}
+			if (!rcv_buffer_.rd_ready()) {
+				// 缓存为空时直接在本次读到的数据上解析, 只把不完整的尾部放进缓存
+				std::size_t used = this->parse_frames(s.data(), s.size(), fn, sfn, ec);
+				if (!ec && used < s.size()) {
+					this->reserve_pending(s.size() - used);
+					rcv_buffer_.put(s.data() + used, static_cast<unsigned int>(s.size() - used));
 				}
-			} while (0);
+				return ec;
+			}
+			rcv_buffer_.put(s.data(), static_cast<unsigned int>(s.size()));
+			std::size_t used = this->parse_frames(const_cast<char*>(rcv_buffer_.rd_buf()), rcv_buffer_.rd_size(), fn, sfn, ec);
+			if (!ec && used > 0)
+				rcv_buffer_.rd_flip(static_cast<unsigned int>(used));
+			if (!ec)
+				this->reserve_pending(rcv_buffer_.rd_size());
+			return ec;
 		}
+
+		// 大帧只收到一部分时, 按整帧长度一次预留好缓存, 避免逐次扩容
+		inline void reserve_pending(std::size_t buffered) {
+			if (this->pending_ > buffered)
+				rcv_buffer_.wr_reserve(static_cast<unsigned int>(this->pending_ - buffered));
+		}
+
+		inline void reset() {
+			this->pending_ = 0;
+			this->frag_compressed_ = false;
+			this->streaming_ = false;
+			this->stream_left_ = 0;
+			this->utf8_.reset();
+			rcv_buffer_.reset();
+			frag_.clear();
+			frag_opcode_ = ws_opcode::continuation;
+		}
+
 		// 关闭握手日志：关闭code，关闭reason.
-		inline void close_log(const std::string& closedata) {
-			constexpr int codelen = sizeof(std::uint16_t);
-			if (closedata.length() <= codelen) {
+		inline void close_log(std::string_view closedata) {
+			constexpr std::size_t codelen = sizeof(std::uint16_t);
+			if (closedata.length() < codelen) {
 				return;
 			}
-			std::uint16_t close_code = ntohs(*(std::uint16_t*)(closedata.data()));
-			std::string close_reason;
-			int reasonLen = ws_header_.reallength - codelen;
-			if (reasonLen > 0) {
-				close_reason = closedata.substr(codelen, reasonLen);
-			}
-			std::cout << "websocket_close_handshark closecode:" << close_code << ", close reason:" << close_reason << std::endl;
+			std::uint16_t close_code = static_cast<std::uint16_t>((static_cast<std::uint8_t>(closedata[0]) << 8) | static_cast<std::uint8_t>(closedata[1]));
+			NET_LOG_INFO("websocket close handshark code: {}, reason: {}", close_code, closedata.substr(codelen));
 		}
 		
+
 	private:
-		HEADER_MAP header_map_;
+		std::string hs_buffer_;						//不完整的升级请求/响应, 一般用不到
+		bool client_ = false;						//客户端: 发出的帧都带掩码
+		char accept_[ws_accept_key_size] = { 0 };	//客户端: 期望的Sec-WebSocket-Accept
 
 		WebSocketHeader ws_header_;
 
 		ProtoEnv penv_;
 
-		t_buffer_cmdqueue<> rcv_buffer_;
+		BUFFER rcv_buffer_;
 		t_buffer_cmdqueue<> snd_buffer_;
+
+		std::size_t max_message_size_ = 16 * 1024 * 1024;
+		std::size_t pending_ = 0;					//未收全的帧的长度
+		std::string frag_;							//分片消息的负载
+		ws_opcode frag_opcode_ = ws_opcode::continuation;	//分片消息的类型, continuation表示没有未完成的分片
+		std::atomic<std::uint8_t> msg_opcode_{ 2 };		//最近收到的数据消息类型, 回复时沿用
+		bool frag_compressed_ = false;				//分片消息的第一帧带了rsv1
+		bool validate_utf8_ = true;
+		std::size_t stream_size_ = 0;				//流式接收的阈值, 0关闭
+		bool streaming_ = false;					//当前消息在流式接收(begin之后end之前)
+		std::uint64_t stream_left_ = 0;				//流式接收的帧还没收到的负载
+		std::size_t stream_phase_ = 0;				//流式接收的帧的掩码相位
+		ws_utf8_stream utf8_;						//未压缩文本分片的校验状态
+#if defined(NET_USE_ZLIB)
+		bool deflate_enable_ = false;
+		ws_deflate deflate_;
+		std::string inflate_buf_;					//解压后的消息, 回调返回后复用
+#endif
 	};
+	using WebSocket = basic_websocket<>;
 }
 
@@ -0,0 +1,384 @@
+#pragma once
+
+/*
+* websocket permessage-deflate(RFC 7692), 需要定义NET_USE_ZLIB并链接zlib.
+* 握手时按default_traits::ws_deflate协商窗口大小和上下文复用(context takeover):
+*	复用上下文: 每个session持有自己的z_stream, 压缩率高, 每个连接常驻几百KB内存;
+*	不复用上下文: 每条消息从当前线程的z_stream池借用, 用完reset归还, 内存只和线程数相关.
+* 小于min_size的消息不压缩. 压缩/解压的字节数和耗时累计在ws_deflate_stats中.
+*/
+
+#if defined(NET_USE_ZLIB)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+
+#include "tool/noncopyable.hpp"
+
+namespace net {
+	struct ws_deflate_options {
+		int level = 1;							// 压缩级别, json之类的文本1~3已经足够
+		int mem_level = 8;
+		int server_max_window_bits = 15;		// 服务端压缩窗口(9~15)
+		int client_max_window_bits = 15;		// 要求客户端使用的压缩窗口(客户端声明支持时才下发)
+		bool server_no_context_takeover = false;	// 服务端每条消息重置压缩上下文
+		bool client_no_context_takeover = false;	// 要求客户端每条消息重置压缩上下文
+		std::size_t min_size = 256;				// 小于该长度的消息不压缩
+	};
+
+	// 全局统计, 各线程累加
+	struct ws_deflate_stats {
+		std::atomic<std::uint64_t> deflate_count{ 0 };
+		std::atomic<std::uint64_t> deflate_in{ 0 };		// 压缩前字节数
+		std::atomic<std::uint64_t> deflate_out{ 0 };	// 压缩后字节数
+		std::atomic<std::uint64_t> deflate_ns{ 0 };
+		std::atomic<std::uint64_t> inflate_count{ 0 };
+		std::atomic<std::uint64_t> inflate_in{ 0 };
+		std::atomic<std::uint64_t> inflate_out{ 0 };
+		std::atomic<std::uint64_t> inflate_ns{ 0 };
+
+		static inline ws_deflate_stats& instance() {
+			static ws_deflate_stats inst;
+			return inst;
+		}
+		// 发送方向的压缩率(压缩后/压缩前)
+		inline double deflate_ratio() const {
+			std::uint64_t in = deflate_in.load(std::memory_order_relaxed);
+			return in ? static_cast<double>(deflate_out.load(std::memory_order_relaxed)) / in : 1.0;
+		}
+		inline double inflate_ratio() const {
+			std::uint64_t out = inflate_out.load(std::memory_order_relaxed);
+			return out ? static_cast<double>(inflate_in.load(std::memory_order_relaxed)) / out : 1.0;
+		}
+	};
+
+	class ws_deflater : private noncopyable {
+	public:
+		ws_deflater(int level, int window_bits, int mem_level) : window_bits_(window_bits) {
+			// 负的windowBits表示raw deflate, 没有zlib头和校验
+			this->ok_ = (deflateInit2(&this->zs_, level, Z_DEFLATED, -window_bits, mem_level, Z_DEFAULT_STRATEGY) == Z_OK);
+		}
+		~ws_deflater() {
+			if (this->ok_)
+				deflateEnd(&this->zs_);
+		}
+
+		inline int window_bits() const { return this->window_bits_; }
+
+		// 压缩一条消息, 去掉结尾的00 00 ff ff
+		inline bool compress(std::string_view in, std::string& out, bool reset) {
+			if (!this->ok_)
+				return false;
+			out.resize(deflateBound(&this->zs_, static_cast<uLong>(in.size())) + 16);
+			this->zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+			this->zs_.avail_in = static_cast<uInt>(in.size());
+			std::size_t produced = 0;
+			for (;;) {
+				this->zs_.next_out = reinterpret_cast<Bytef*>(out.data() + produced);
+				this->zs_.avail_out = static_cast<uInt>(out.size() - produced);
+				int ret = deflate(&this->zs_, Z_SYNC_FLUSH);
+				produced = out.size() - this->zs_.avail_out;
+				if (ret != Z_OK && ret != Z_BUF_ERROR) {
+					deflateReset(&this->zs_);
+					return false;
+				}
+				if (this->zs_.avail_out != 0)
+					break;
+				out.resize(out.size() * 2);
+			}
+			if (produced >= 4)
+				produced -= 4;
+			out.resize(produced);
+			if (reset)
+				deflateReset(&this->zs_);
+			return true;
+		}
+
+	protected:
+		z_stream zs_{};
+		int window_bits_ = 15;
+		bool ok_ = false;
+	};
+
+	class ws_inflater : private noncopyable {
+	public:
+		ws_inflater() {
+			// 解压总是用最大窗口, 可以解对端任意窗口大小的数据
+			this->ok_ = (inflateInit2(&this->zs_, -15) == Z_OK);
+		}
+		~ws_inflater() {
+			if (this->ok_)
+				inflateEnd(&this->zs_);
+		}
+
+		inline int window_bits() const { return 15; }
+
+		// 解压一条消息(补上00 00 ff ff), 结果超过max_size时失败
+		inline bool decompress(std::string_view in, std::string& out, std::size_t max_size, bool reset) {
+			static const char tail[4] = { 0x00, 0x00, char(0xff), char(0xff) };
+			if (!this->ok_)
+				return false;
+			out.resize((std::min)(max_size, (std::max)(in.size() * 4, static_cast<std::size_t>(1024))));
+			std::size_t produced = 0;
+			bool ok = this->feed(in, out, produced, max_size) && this->feed(std::string_view(tail, 4), out, produced, max_size);
+			out.resize(produced);
+			if (reset || !ok)
+				inflateReset(&this->zs_);
+			return ok;
+		}
+
+	protected:
+		inline bool feed(std::string_view in, std::string& out, std::size_t& produced, std::size_t max_size) {
+			this->zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+			this->zs_.avail_in = static_cast<uInt>(in.size());
+			while (this->zs_.avail_in > 0) {
+				if (produced == out.size()) {
+					if (out.size() >= max_size)
+						return false;
+					out.resize((std::min)(max_size, out.size() * 2));
+				}
+				this->zs_.next_out = reinterpret_cast<Bytef*>(out.data() + produced);
+				this->zs_.avail_out = static_cast<uInt>(out.size() - produced);
+				int ret = inflate(&this->zs_, Z_SYNC_FLUSH);
+				produced = out.size() - this->zs_.avail_out;
+				if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
+					return false;
+				if (ret == Z_BUF_ERROR && this->zs_.avail_out != 0)
+					return false;
+			}
+			// 输入已经吃完, 但可能还有数据留在zlib内部等待输出
+			while (this->zs_.avail_out == 0) {
+				if (out.size() >= max_size)
+					return false;
+				out.resize((std::min)(max_size, out.size() * 2));
+				this->zs_.next_out = reinterpret_cast<Bytef*>(out.data() + produced);
+				this->zs_.avail_out = static_cast<uInt>(out.size() - produced);
+				int ret = inflate(&this->zs_, Z_SYNC_FLUSH);
+				produced = out.size() - this->zs_.avail_out;
+				if (ret == Z_BUF_ERROR)
+					break;
+				if (ret != Z_OK && ret != Z_STREAM_END)
+					return false;
+			}
+			return true;
+		}
+
+	protected:
+		z_stream zs_{};
+		bool ok_ = false;
+	};
+
+	// 每个线程缓存少量已经初始化的z_stream, 不复用上下文时按消息借用
+	template<class T>
+	class ws_stream_pool {
+	public:
+		static constexpr std::size_t max_cached = 4;
+
+		struct deleter {
+			inline void operator()(T* p) const { ws_stream_pool::release(p); }
+		};
+		using pointer = std::unique_ptr<T, deleter>;
+
+		template<class ...Args>
+		static inline pointer acquire(int window_bits, Args&&... args) {
+			auto& cache = local();
+			for (auto itr = cache.begin(); itr != cache.end(); ++itr) {
+				if ((*itr)->window_bits() == window_bits) {
+					T* p = itr->release();
+					cache.erase(itr);
+					return pointer(p);
+				}
+			}
+			return pointer(new T(std::forward<Args>(args)...));
+		}
+
+	protected:
+		static inline std::vector<std::unique_ptr<T>>& local() {
+			thread_local std::vector<std::unique_ptr<T>> cache;
+			return cache;
+		}
+		static inline void release(T* p) {
+			auto& cache = local();
+			if (cache.size() < max_cached)
+				cache.emplace_back(p);
+			else
+				delete p;
+		}
+	};
+
+	class ws_deflate {
+	public:
+		inline void options(const ws_deflate_options& opts) { this->opts_ = opts; }
+		inline bool active() const { return this->active_; }
+		inline std::size_t min_size() const { return this->opts_.min_size; }
+		// 复用压缩上下文时, 压缩顺序必须和发送顺序一致
+		inline bool need_send_order() const { return this->active_ && !this->srv_no_takeover_; }
+		inline std::mutex& send_mutex() { return this->send_mutex_; }
+
+		inline void reset() {
+			this->active_ = false;
+			this->deflater_.reset();
+			this->inflater_.reset();
+		}
+
+		// 根据客户端的Sec-WebSocket-Extensions协商, 成功时返回响应的扩展参数, 否则返回空
+		inline std::string negotiate(std::string_view offers) {
+			this->reset();
+			while (!offers.empty()) {
+				std::size_t comma = offers.find(',');
+				std::string_view offer = offers.substr(0, comma);
+				offers = (comma == std::string_view::npos) ? std::string_view() : offers.substr(comma + 1);
+				std::string response;
+				if (this->accept_offer(offer, response)) {
+					this->active_ = true;
+					return response;
+				}
+			}
+			return std::string();
+		}
+
+		inline bool compress(std::string_view in, std::string& out) {
+			auto begin = std::chrono::steady_clock::now();
+			bool ret = false;
+			if (this->srv_no_takeover_) {
+				auto d = ws_stream_pool<ws_deflater>::acquire(this->srv_bits_, this->opts_.level, this->srv_bits_, this->opts_.mem_level);
+				ret = d->compress(in, out, true);
+			}
+			else {
+				if (!this->deflater_)
+					this->deflater_ = std::make_unique<ws_deflater>(this->opts_.level, this->srv_bits_, this->opts_.mem_level);
+				ret = this->deflater_->compress(in, out, false);
+			}
+			auto& stats = ws_deflate_stats::instance();
+			stats.deflate_count.fetch_add(1, std::memory_order_relaxed);
+			stats.deflate_in.fetch_add(in.size(), std::memory_order_relaxed);
+			stats.deflate_out.fetch_add(out.size(), std::memory_order_relaxed);
+			stats.deflate_ns.fetch_add(elapsed_ns(begin), std::memory_order_relaxed);
+			return ret;
+		}
+
+		inline bool decompress(std::string_view in, std::string& out, std::size_t max_size) {
+			auto begin = std::chrono::steady_clock::now();
+			bool ret = false;
+			if (this->cli_no_takeover_) {
+				auto i = ws_stream_pool<ws_inflater>::acquire(15);
+				ret = i->decompress(in, out, max_size, true);
+			}
+			else {
+				if (!this->inflater_)
+					this->inflater_ = std::make_unique<ws_inflater>();
+				ret = this->inflater_->decompress(in, out, max_size, false);
+			}
+			auto& stats = ws_deflate_stats::instance();
+			stats.inflate_count.fetch_add(1, std::memory_order_relaxed);
+			stats.inflate_in.fetch_add(in.size(), std::memory_order_relaxed);
+			stats.inflate_out.fetch_add(out.size(), std::memory_order_relaxed);
+			stats.inflate_ns.fetch_add(elapsed_ns(begin), std::memory_order_relaxed);
+			return ret;
+		}
+
+	protected:
+		static inline std::uint64_t elapsed_ns(std::chrono::steady_clock::time_point begin) {
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - begin).count());
+		}
+
+		static inline std::string_view trim(std::string_view s) {
+			while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+				s.remove_prefix(1);
+			while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+				s.remove_suffix(1);
+			if (s.size() >= 2 && s.front() == '"' && s.back() == '"')
+				s = s.substr(1, s.size() - 2);
+			return s;
+		}
+
+		static inline int parse_bits(std::string_view v) {
+			if (v.size() < 1 || v.size() > 2)
+				return -1;
+			int bits = 0;
+			for (char c : v) {
+				if (c < '0' || c > '9')
+					return -1;
+				bits = bits * 10 + (c - '0');
+			}
+			return (bits >= 8 && bits <= 15) ? bits : -1;
+		}
+
+		inline bool accept_offer(std::string_view offer, std::string& response) {
+			std::size_t semi = offer.find(';');
+			if (trim(offer.substr(0, semi)) != "permessage-deflate")
+				return false;
+			bool srv_no_takeover = this->opts_.server_no_context_takeover;
+			bool cli_no_takeover = this->opts_.client_no_context_takeover;
+			int srv_bits = this->opts_.server_max_window_bits;
+			int cli_bits = -1;	// 客户端没有声明client_max_window_bits时不能下发
+			while (semi != std::string_view::npos) {
+				offer = offer.substr(semi + 1);
+				semi = offer.find(';');
+				std::string_view param = offer.substr(0, semi);
+				std::size_t eq = param.find('=');
+				std::string_view name = trim(param.substr(0, eq));
+				std::string_view value = (eq == std::string_view::npos) ? std::string_view() : trim(param.substr(eq + 1));
+				if (name == "server_no_context_takeover") {
+					srv_no_takeover = true;
+				}
+				else if (name == "client_no_context_takeover") {
+					cli_no_takeover = true;
+				}
+				else if (name == "server_max_window_bits") {
+					int bits = parse_bits(value);
+					if (bits < 0)
+						return false;
+					srv_bits = (std::min)(srv_bits, bits);
+				}
+				else if (name == "client_max_window_bits") {
+					int bits = value.empty() ? 15 : parse_bits(value);
+					if (bits < 0)
+						return false;
+					cli_bits = (std::min)(this->opts_.client_max_window_bits, bits);
+				}
+				else {
+					return false;
+				}
+			}
+			// zlib的raw deflate不支持8位窗口
+			if (srv_bits < 9)
+				return false;
+
+			this->srv_no_takeover_ = srv_no_takeover;
+			this->cli_no_takeover_ = cli_no_takeover;
+			this->srv_bits_ = srv_bits;
+			response = "permessage-deflate";
+			if (srv_no_takeover)
+				response.append("; server_no_context_takeover");
+			if (cli_no_takeover)
+				response.append("; client_no_context_takeover");
+			if (srv_bits < 15)
+				response.append("; server_max_window_bits=").append(std::to_string(srv_bits));
+			if (cli_bits > 0 && cli_bits < 15)
+				response.append("; client_max_window_bits=").append(std::to_string(cli_bits));
+			return true;
+		}
+
+	protected:
+		ws_deflate_options opts_;
+		bool active_ = false;
+		bool srv_no_takeover_ = false;
+		bool cli_no_takeover_ = false;
+		int srv_bits_ = 15;
+		std::unique_ptr<ws_deflater> deflater_;
+		std::unique_ptr<ws_inflater> inflater_;
+		std::mutex send_mutex_;
+	};
+}
+
+#endif
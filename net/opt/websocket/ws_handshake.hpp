@@ -0,0 +1,319 @@
+#pragma once
+
+/*
+* websocket升级请求(握手)解析, 一遍扫描, 不拷贝不分配:
+*	只取需要的头部, 结果是指向接收数据的string_view, 头部名大小写不敏感;
+*	请求不完整时返回0, 由调用方缓存后带上后续数据重新解析.
+* 客户端的升级响应用同样的方式解析.
+* Sec-WebSocket-Accept计算到栈上的定长缓存; 定义了NET_USE_SSL时使用openssl的SHA1(有硬件加速), 否则用自带的sha1.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "base/error.hpp"
+#include "opt/common/sha1.hpp"
+#include "opt/common/md5.hpp"
+
+#if defined(NET_USE_SSL)
+#include <openssl/sha.h>
+#endif
+
+namespace net {
+	// 升级请求中用到的字段, 指向原始数据
+	struct ws_upgrade_request {
+		std::string_view path;
+		std::string_view host;
+		std::string_view origin;
+		std::string_view upgrade;
+		std::string_view key;
+		std::string_view key1;			// hixie-76(老版本safari)
+		std::string_view key2;
+		std::string_view key3;			// hixie-76: 头部之后的8字节
+		std::string_view protocol;
+		std::string_view extensions;
+	};
+
+	// 升级响应中用到的字段(客户端), 指向原始数据
+	struct ws_upgrade_response {
+		int status = 0;
+		std::string_view upgrade;
+		std::string_view accept;
+		std::string_view extensions;
+	};
+
+	// 握手请求/响应, 定长缓存
+	struct ws_handshake_response {
+		char data[1024];
+		std::size_t size = 0;
+
+		inline bool append(std::string_view s) {
+			if (s.size() > sizeof(data) - size)
+				return false;
+			std::memcpy(data + size, s.data(), s.size());
+			size += s.size();
+			return true;
+		}
+		inline std::string_view view() const { return std::string_view(data, size); }
+	};
+
+	constexpr std::size_t ws_accept_key_size = 28;
+	// 升级请求的最大长度, 超过时按错误处理
+	constexpr std::size_t ws_max_upgrade_request = 8192;
+
+	namespace ws_handshake_detail {
+		inline char lower(char c) {
+			return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+		}
+
+		// name为小写
+		inline bool iequals(std::string_view s, std::string_view name) {
+			if (s.size() != name.size())
+				return false;
+			for (std::size_t i = 0; i < s.size(); ++i) {
+				if (lower(s[i]) != name[i])
+					return false;
+			}
+			return true;
+		}
+
+		// token为小写
+		inline bool icontains(std::string_view s, std::string_view token) {
+			if (token.size() > s.size())
+				return false;
+			for (std::size_t i = 0; i + token.size() <= s.size(); ++i) {
+				if (iequals(s.substr(i, token.size()), token))
+					return true;
+			}
+			return false;
+		}
+
+		inline std::string_view trim(std::string_view s) {
+			while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+				s.remove_prefix(1);
+			while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+				s.remove_suffix(1);
+			return s;
+		}
+
+		inline void assign_header(ws_upgrade_request& req, std::string_view name, std::string_view value) {
+			// 先按长度分流, 每个头部最多比较两次
+			switch (name.size()) {
+			case 4:
+				if (iequals(name, "host")) req.host = value;
+				break;
+			case 6:
+				if (iequals(name, "origin")) req.origin = value;
+				break;
+			case 7:
+				if (iequals(name, "upgrade")) req.upgrade = value;
+				break;
+			case 17:
+				if (iequals(name, "sec-websocket-key")) req.key = value;
+				break;
+			case 18:
+				if (iequals(name, "sec-websocket-key1")) req.key1 = value;
+				else if (iequals(name, "sec-websocket-key2")) req.key2 = value;
+				break;
+			case 22:
+				if (iequals(name, "sec-websocket-protocol")) req.protocol = value;
+				break;
+			case 24:
+				if (iequals(name, "sec-websocket-extensions")) req.extensions = value;
+				break;
+			default:
+				break;
+			}
+		}
+
+		// 扫描起始行和头部直到空行, 返回头部之后的位置; 数据不完整返回0, 超长时设置ec
+		template<class Fn>
+		inline std::size_t parse_head(std::string_view data, std::string_view& first_line, Fn&& on_header, error_code& ec) {
+			std::size_t pos = 0;
+			bool first = true;
+			for (;;) {
+				const char* nl = static_cast<const char*>(std::memchr(data.data() + pos, '\n', data.size() - pos));
+				if (nl == nullptr) {
+					if (data.size() > ws_max_upgrade_request)
+						ec = asio::error::message_size;
+					return 0;
+				}
+				std::size_t end = static_cast<std::size_t>(nl - data.data());
+				std::string_view line = data.substr(pos, end - pos);
+				if (!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+				pos = end + 1;
+				if (first) {
+					first = false;
+					first_line = line;
+					continue;
+				}
+				if (line.empty())
+					break;
+				std::size_t colon = line.find(':');
+				if (colon == std::string_view::npos)
+					continue;
+				on_header(line.substr(0, colon), trim(line.substr(colon + 1)));
+			}
+			if (pos > ws_max_upgrade_request) {
+				ec = asio::error::message_size;
+				return 0;
+			}
+			return pos;
+		}
+
+		// data可能不完整, 只比较已有的部分
+		inline bool starts_with(std::string_view data, std::string_view prefix) {
+			return std::memcmp(data.data(), prefix.data(), (std::min)(data.size(), prefix.size())) == 0;
+		}
+
+		inline void base64_encode(const unsigned char* in, std::size_t len, char* out) {
+			static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			std::size_t i = 0;
+			for (; i + 3 <= len; i += 3) {
+				std::uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+				*out++ = table[(v >> 18) & 0x3f];
+				*out++ = table[(v >> 12) & 0x3f];
+				*out++ = table[(v >> 6) & 0x3f];
+				*out++ = table[v & 0x3f];
+			}
+			if (i < len) {
+				std::uint32_t v = in[i] << 16;
+				if (i + 1 < len)
+					v |= in[i + 1] << 8;
+				*out++ = table[(v >> 18) & 0x3f];
+				*out++ = table[(v >> 12) & 0x3f];
+				*out++ = (i + 1 < len) ? table[(v >> 6) & 0x3f] : '=';
+				*out++ = '=';
+			}
+		}
+
+		// hixie-76: key中的数字除以空格数
+		inline std::uint32_t decode_hixie_key(std::string_view key) {
+			std::uint64_t num = 0;
+			std::uint32_t spaces = 0;
+			for (char c : key) {
+				if (c == ' ')
+					++spaces;
+				else if (c >= '0' && c <= '9')
+					num = (num * 10 + static_cast<std::uint64_t>(c - '0')) & 0xffffffffffULL;
+			}
+			if (spaces == 0 || num == 0 || num > 0xffffffffULL)
+				return 0;
+			return static_cast<std::uint32_t>(num / spaces);
+		}
+	}
+
+	// 解析升级请求, 返回请求占用的字节数; 数据不完整返回0, 请求非法时设置ec
+	inline std::size_t ws_parse_upgrade(std::string_view data, ws_upgrade_request& req, error_code& ec) {
+		using namespace ws_handshake_detail;
+		req = ws_upgrade_request();
+		if (!starts_with(data, "GET ")) {
+			ec = asio::error::invalid_argument;
+			return 0;
+		}
+		std::string_view line;
+		std::size_t pos = parse_head(data, line, [&req](std::string_view name, std::string_view value) {
+			assign_header(req, name, value);
+		}, ec);
+		if (pos == 0)
+			return 0;
+		// GET <path> HTTP/1.1
+		line.remove_prefix(4);
+		std::size_t sp = line.find(' ');
+		if (sp == std::string_view::npos || line.substr(sp + 1, 5) != "HTTP/") {
+			ec = asio::error::invalid_argument;
+			return 0;
+		}
+		req.path = line.substr(0, sp);
+		if (!icontains(req.upgrade, "websocket") || (req.key.empty() && (req.key1.empty() || req.key2.empty()))) {
+			ec = asio::error::invalid_argument;
+			return 0;
+		}
+		if (req.key.empty()) {
+			// hixie-76的key3在头部之后
+			if (data.size() < pos + 8)
+				return 0;
+			req.key3 = data.substr(pos, 8);
+			pos += 8;
+		}
+		return pos;
+	}
+
+	// 解析升级响应, 返回响应占用的字节数; 数据不完整返回0, 响应非法时设置ec
+	inline std::size_t ws_parse_upgrade_response(std::string_view data, ws_upgrade_response& resp, error_code& ec) {
+		using namespace ws_handshake_detail;
+		resp = ws_upgrade_response();
+		if (!starts_with(data, "HTTP/1.")) {
+			ec = asio::error::invalid_argument;
+			return 0;
+		}
+		std::string_view line;
+		std::size_t pos = parse_head(data, line, [&resp](std::string_view name, std::string_view value) {
+			if (iequals(name, "upgrade")) resp.upgrade = value;
+			else if (iequals(name, "sec-websocket-accept")) resp.accept = value;
+			else if (iequals(name, "sec-websocket-extensions")) resp.extensions = value;
+		}, ec);
+		if (pos == 0)
+			return 0;
+		// HTTP/1.1 101 Switching Protocols
+		std::size_t sp = line.find(' ');
+		if (sp == std::string_view::npos || line.size() < sp + 4) {
+			ec = asio::error::invalid_argument;
+			return 0;
+		}
+		for (std::size_t i = sp + 1; i < sp + 4; ++i) {
+			if (line[i] < '0' || line[i] > '9') {
+				ec = asio::error::invalid_argument;
+				return 0;
+			}
+			resp.status = resp.status * 10 + (line[i] - '0');
+		}
+		return pos;
+	}
+
+	// Sec-WebSocket-Accept = base64(sha1(key + GUID)), 写入out(ws_accept_key_size字节), key非法返回false
+	inline bool ws_accept_key(std::string_view key, char* out) {
+		constexpr std::string_view guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+		char input[64 + guid.size()];
+		if (key.empty() || key.size() > 64)
+			return false;
+		std::memcpy(input, key.data(), key.size());
+		std::memcpy(input + key.size(), guid.data(), guid.size());
+		unsigned char digest[20];
+#if defined(NET_USE_SSL)
+		SHA1(reinterpret_cast<const unsigned char*>(input), key.size() + guid.size(), digest);
+#else
+		sha1::calc(input, key.size() + guid.size(), digest);
+#endif
+		ws_handshake_detail::base64_encode(digest, sizeof(digest), out);
+		return true;
+	}
+
+	// 客户端的Sec-WebSocket-Key: base64(16字节随机数), 写入out(ws_client_key_size字节)
+	constexpr std::size_t ws_client_key_size = 24;
+	inline void ws_client_key(const unsigned char nonce[16], char* out) {
+		ws_handshake_detail::base64_encode(nonce, 16, out);
+	}
+
+	// hixie-76的应答: md5(key1数值 + key2数值 + key3), 写入out(16字节)
+	inline bool ws_hixie_answer(const ws_upgrade_request& req, char* out) {
+		if (req.key3.size() != 8)
+			return false;
+		unsigned char input[16];
+		std::uint32_t n1 = ws_handshake_detail::decode_hixie_key(req.key1);
+		std::uint32_t n2 = ws_handshake_detail::decode_hixie_key(req.key2);
+		for (int i = 0; i < 4; ++i) {
+			input[i] = static_cast<unsigned char>(n1 >> (24 - 8 * i));
+			input[4 + i] = static_cast<unsigned char>(n2 >> (24 - 8 * i));
+		}
+		std::memcpy(input + 8, req.key3.data(), 8);
+		md5::md5_state_t state;
+		md5::md5_init(&state);
+		md5::md5_append(&state, input, sizeof(input));
+		md5::md5_finish(&state, reinterpret_cast<md5::md5_byte_t*>(out));
+		return true;
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+* websocket负载掩码: data[i] ^= key[(phase + i) % 4], 原地处理, 掩码和解码是同一个操作.
+* x86下按cpu在运行期选择AVX2(32字节)或SSE2(16字节), 其余平台按64位字处理, 尾部逐字节.
+* phase为起始位置在掩码中的偏移, 返回处理完之后的偏移; 一帧分多次处理(跨读)时把返回值传给下一次.
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NET_WS_MASK_X86 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define NET_WS_MASK_AVX2 1
+#endif
+#endif
+
+namespace net {
+	namespace ws_mask_detail {
+		// 从phase开始旋转过的4字节掩码, 按内存顺序重复成64位
+		inline std::uint64_t rolled_key64(const std::uint8_t key[4], std::size_t phase) {
+			std::uint8_t rolled[8];
+			for (std::size_t i = 0; i < 8; ++i) {
+				rolled[i] = key[(phase + i) & 0x3];
+			}
+			std::uint64_t k;
+			std::memcpy(&k, rolled, 8);
+			return k;
+		}
+
+		inline std::size_t mask_words(char* data, std::size_t len, std::uint64_t k) {
+			std::size_t i = 0;
+			for (; i + 8 <= len; i += 8) {
+				std::uint64_t v;
+				std::memcpy(&v, data + i, 8);
+				v ^= k;
+				std::memcpy(data + i, &v, 8);
+			}
+			return i;
+		}
+
+#if defined(NET_WS_MASK_X86)
+		inline std::size_t mask_sse2(char* data, std::size_t len, std::uint64_t k) {
+			__m128i key = _mm_set1_epi64x(static_cast<long long>(k));
+			std::size_t i = 0;
+			for (; i + 64 <= len; i += 64) {
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+				__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 32));
+				__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 48));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(a, key));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 16), _mm_xor_si128(b, key));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 32), _mm_xor_si128(c, key));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 48), _mm_xor_si128(d, key));
+			}
+			for (; i + 16 <= len; i += 16) {
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(a, key));
+			}
+			return i;
+		}
+#endif
+
+#if defined(NET_WS_MASK_AVX2)
+		__attribute__((target("avx2")))
+		inline std::size_t mask_avx2(char* data, std::size_t len, std::uint64_t k) {
+			__m256i key = _mm256_set1_epi64x(static_cast<long long>(k));
+			std::size_t i = 0;
+			for (; i + 128 <= len; i += 128) {
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+				__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 64));
+				__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 96));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(a, key));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 32), _mm256_xor_si256(b, key));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 64), _mm256_xor_si256(c, key));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 96), _mm256_xor_si256(d, key));
+			}
+			for (; i + 32 <= len; i += 32) {
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(a, key));
+			}
+			return i;
+		}
+#endif
+
+		using mask_func = std::size_t(*)(char*, std::size_t, std::uint64_t);
+
+		inline mask_func select_mask_func() {
+#if defined(NET_WS_MASK_AVX2)
+			if (__builtin_cpu_supports("avx2"))
+				return &mask_avx2;
+#endif
+#if defined(NET_WS_MASK_X86)
+			return &mask_sse2;
+#else
+			return &mask_words;
+#endif
+		}
+	}
+
+	inline std::size_t ws_mask(char* data, std::size_t len, const std::uint8_t key[4], std::size_t phase = 0) {
+		phase &= 0x3;
+		std::size_t i = 0;
+		if (len >= 16) {
+			static const ws_mask_detail::mask_func func = ws_mask_detail::select_mask_func();
+			std::uint64_t k = ws_mask_detail::rolled_key64(key, phase);
+			i = func(data, len, k);
+			// 向量部分处理的长度是8的倍数, 掩码相位不变
+			i += ws_mask_detail::mask_words(data + i, len - i, k);
+		}
+		for (; i < len; ++i) {
+			data[i] ^= static_cast<char>(key[(phase + i) & 0x3]);
+		}
+		return (phase + len) & 0x3;
+	}
+}
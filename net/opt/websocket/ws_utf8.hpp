@@ -0,0 +1,327 @@
+#pragma once
+
+/*
+* UTF-8校验(RFC 3629, 排除代理区/超长编码/大于U+10FFFF), websocket文本消息和关闭原因使用.
+* x86下按cpu在运行期选择AVX2(32字节)或SSSE3(16字节)查表算法(Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"):
+*	每块用三次pshufb查出相邻字节组合的错误类别, 纯ASCII块直接跳过; 其余平台按8字节跳过ASCII, 非ASCII逐字符检查.
+* ws_utf8_stream用于分片消息: 每片到达时校验, 片尾不完整的字符(最多3字节)留到下一片.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if defined(__GNUC__) || defined(__clang__)
+#define NET_WS_UTF8_X86 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace net {
+	namespace ws_utf8_detail {
+		// 逐字符检查, 用于没有simd的平台和很短的数据
+		inline bool validate_scalar(const unsigned char* s, std::size_t len) {
+			std::size_t i = 0;
+			while (i < len) {
+				if (i + 8 <= len) {
+					std::uint64_t v;
+					std::memcpy(&v, s + i, 8);
+					if ((v & 0x8080808080808080ULL) == 0) {
+						i += 8;
+						continue;
+					}
+				}
+				unsigned char c = s[i];
+				if (c < 0x80) {
+					++i;
+					continue;
+				}
+				std::size_t n;
+				std::uint32_t cp;
+				if (c >= 0xC2 && c <= 0xDF) { n = 2; cp = c & 0x1F; }
+				else if (c >= 0xE0 && c <= 0xEF) { n = 3; cp = c & 0x0F; }
+				else if (c >= 0xF0 && c <= 0xF4) { n = 4; cp = c & 0x07; }
+				else return false;
+				if (i + n > len)
+					return false;
+				for (std::size_t k = 1; k < n; ++k) {
+					if ((s[i + k] & 0xC0) != 0x80)
+						return false;
+					cp = (cp << 6) | (s[i + k] & 0x3F);
+				}
+				if ((n == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) || (n == 4 && (cp < 0x10000 || cp > 0x10FFFF)))
+					return false;
+				i += n;
+			}
+			return true;
+		}
+
+#if defined(NET_WS_UTF8_X86)
+		// 错误类别, 见论文中的表
+		constexpr std::uint8_t TOO_SHORT = 1 << 0;		// 11______ 0_______ / 11______ 11______
+		constexpr std::uint8_t TOO_LONG = 1 << 1;		// 0_______ 10______
+		constexpr std::uint8_t OVERLONG_3 = 1 << 2;		// 11100000 100_____
+		constexpr std::uint8_t TOO_LARGE = 1 << 3;		// 11110100 1001____ / 11110101+
+		constexpr std::uint8_t SURROGATE = 1 << 4;		// 11101101 101_____
+		constexpr std::uint8_t OVERLONG_2 = 1 << 5;		// 1100000_ 10______
+		constexpr std::uint8_t TOO_LARGE_1000 = 1 << 6;	// 11110101+ 1000____
+		constexpr std::uint8_t OVERLONG_4 = 1 << 6;		// 11110000 1000____
+		constexpr std::uint8_t TWO_CONTS = 1 << 7;		// 10______ 10______
+		constexpr std::uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+#define NET_WS_UTF8_BYTE1_HIGH \
+			TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, \
+			TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS, \
+			TOO_SHORT | OVERLONG_2, \
+			TOO_SHORT, \
+			TOO_SHORT | OVERLONG_3 | SURROGATE, \
+			TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+#define NET_WS_UTF8_BYTE1_LOW \
+			CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, \
+			CARRY | OVERLONG_2, \
+			CARRY, \
+			CARRY, \
+			CARRY | TOO_LARGE, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000, \
+			CARRY | TOO_LARGE | TOO_LARGE_1000
+#define NET_WS_UTF8_BYTE2_HIGH \
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, \
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4, \
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE, \
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+
+		alignas(32) static const std::uint8_t byte1_high_table[32] = { NET_WS_UTF8_BYTE1_HIGH, NET_WS_UTF8_BYTE1_HIGH };
+		alignas(32) static const std::uint8_t byte1_low_table[32] = { NET_WS_UTF8_BYTE1_LOW, NET_WS_UTF8_BYTE1_LOW };
+		alignas(32) static const std::uint8_t byte2_high_table[32] = { NET_WS_UTF8_BYTE2_HIGH, NET_WS_UTF8_BYTE2_HIGH };
+		// 块尾3个字节中的多字节字符开头, 要求下一块接续; 大于等于对应值即为不完整
+		alignas(32) static const std::uint8_t incomplete_table[32] = {
+			255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+			255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1 };
+#undef NET_WS_UTF8_BYTE1_HIGH
+#undef NET_WS_UTF8_BYTE1_LOW
+#undef NET_WS_UTF8_BYTE2_HIGH
+
+		// 一块的检查: 每个字节和前1~3个字节一起查出错误类别, prev_*为上一块的状态
+		struct ssse3_state {
+			__m128i error;
+			__m128i prev_input;
+			__m128i prev_incomplete;
+		};
+
+		__attribute__((target("ssse3"), always_inline))
+		inline void check_ssse3(ssse3_state& st, __m128i input) {
+			if (_mm_movemask_epi8(input) == 0) {
+				// 纯ASCII: 只需要确认上一块没有未完成的字符
+				st.error = _mm_or_si128(st.error, st.prev_incomplete);
+				st.prev_incomplete = _mm_setzero_si128();
+				st.prev_input = input;
+				return;
+			}
+			const __m128i nibble = _mm_set1_epi8(0x0F);
+			__m128i prev1 = _mm_alignr_epi8(input, st.prev_input, 15);
+			__m128i sc = _mm_and_si128(_mm_and_si128(
+				_mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(byte1_high_table)), _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+				_mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(byte1_low_table)), _mm_and_si128(prev1, nibble))),
+				_mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(byte2_high_table)), _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+			// 3/4字节字符的第2/3个后续字节是合法的"两个连续的后续字节"
+			__m128i prev2 = _mm_alignr_epi8(input, st.prev_input, 14);
+			__m128i prev3 = _mm_alignr_epi8(input, st.prev_input, 13);
+			__m128i must23 = _mm_and_si128(_mm_or_si128(
+				_mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80))),
+				_mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)))), _mm_set1_epi8(static_cast<char>(0x80)));
+			st.error = _mm_or_si128(st.error, _mm_xor_si128(must23, sc));
+			st.prev_incomplete = _mm_subs_epu8(input, _mm_load_si128(reinterpret_cast<const __m128i*>(incomplete_table + 16)));
+			st.prev_input = input;
+		}
+
+		// 返回true表示合法; 不足一块的尾部补空格后按整块处理
+		__attribute__((target("ssse3")))
+		inline bool validate_ssse3(const unsigned char* s, std::size_t len) {
+			ssse3_state st{ _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+			std::size_t i = 0;
+			for (; i + 16 <= len; i += 16) {
+				check_ssse3(st, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)));
+			}
+			if (i < len) {
+				alignas(16) unsigned char tail[16];
+				std::memset(tail, 0x20, sizeof(tail));
+				std::memcpy(tail, s + i, len - i);
+				check_ssse3(st, _mm_load_si128(reinterpret_cast<const __m128i*>(tail)));
+			}
+			__m128i error = _mm_or_si128(st.error, st.prev_incomplete);
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+		}
+
+		struct avx2_state {
+			__m256i error;
+			__m256i prev_input;
+			__m256i prev_incomplete;
+		};
+
+		__attribute__((target("avx2"), always_inline))
+		inline void check_avx2(avx2_state& st, __m256i input) {
+			if (_mm256_movemask_epi8(input) == 0) {
+				st.error = _mm256_or_si256(st.error, st.prev_incomplete);
+				st.prev_incomplete = _mm256_setzero_si256();
+				st.prev_input = input;
+				return;
+			}
+			const __m256i nibble = _mm256_set1_epi8(0x0F);
+			// 256位的alignr按128位分别移位, 先拼出跨通道的[prev高半, input低半]
+			__m256i cross = _mm256_permute2x128_si256(st.prev_input, input, 0x21);
+			__m256i prev1 = _mm256_alignr_epi8(input, cross, 15);
+			__m256i sc = _mm256_and_si256(_mm256_and_si256(
+				_mm256_shuffle_epi8(_mm256_load_si256(reinterpret_cast<const __m256i*>(byte1_high_table)), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+				_mm256_shuffle_epi8(_mm256_load_si256(reinterpret_cast<const __m256i*>(byte1_low_table)), _mm256_and_si256(prev1, nibble))),
+				_mm256_shuffle_epi8(_mm256_load_si256(reinterpret_cast<const __m256i*>(byte2_high_table)), _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+			__m256i prev2 = _mm256_alignr_epi8(input, cross, 14);
+			__m256i prev3 = _mm256_alignr_epi8(input, cross, 13);
+			__m256i must23 = _mm256_and_si256(_mm256_or_si256(
+				_mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80))),
+				_mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)))), _mm256_set1_epi8(static_cast<char>(0x80)));
+			st.error = _mm256_or_si256(st.error, _mm256_xor_si256(must23, sc));
+			st.prev_incomplete = _mm256_subs_epu8(input, _mm256_load_si256(reinterpret_cast<const __m256i*>(incomplete_table)));
+			st.prev_input = input;
+		}
+
+		__attribute__((target("avx2")))
+		inline bool validate_avx2(const unsigned char* s, std::size_t len) {
+			avx2_state st{ _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+			std::size_t i = 0;
+			for (; i + 64 <= len; i += 64) {
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + 32));
+				if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) == 0) {
+					// 64字节纯ASCII, 常见的情况
+					st.error = _mm256_or_si256(st.error, st.prev_incomplete);
+					st.prev_incomplete = _mm256_setzero_si256();
+					st.prev_input = b;
+					continue;
+				}
+				check_avx2(st, a);
+				check_avx2(st, b);
+			}
+			for (; i + 32 <= len; i += 32) {
+				check_avx2(st, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)));
+			}
+			if (i < len) {
+				alignas(32) unsigned char tail[32];
+				std::memset(tail, 0x20, sizeof(tail));
+				std::memcpy(tail, s + i, len - i);
+				check_avx2(st, _mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+			}
+			__m256i error = _mm256_or_si256(st.error, st.prev_incomplete);
+			return _mm256_testz_si256(error, error) != 0;
+		}
+#endif
+
+		using validate_func = bool(*)(const unsigned char*, std::size_t);
+
+		inline validate_func select_validate_func() {
+#if defined(NET_WS_UTF8_X86)
+			if (__builtin_cpu_supports("avx2"))
+				return &validate_avx2;
+			if (__builtin_cpu_supports("ssse3"))
+				return &validate_ssse3;
+#endif
+			return &validate_scalar;
+		}
+
+		// 多字节字符的总长度, 不是合法的开头字节返回0
+		inline std::size_t sequence_length(unsigned char c) {
+			if (c >= 0xF5) return 0;
+			if (c >= 0xF0) return 4;
+			if (c >= 0xE0) return 3;
+			if (c >= 0xC2) return 2;
+			return 0;
+		}
+	}
+
+	// 校验一段完整的UTF-8
+	inline bool ws_utf8_valid(const char* data, std::size_t len) {
+		const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+		if (len < 16)
+			return ws_utf8_detail::validate_scalar(s, len);
+		static const ws_utf8_detail::validate_func func = ws_utf8_detail::select_validate_func();
+		return func(s, len);
+	}
+
+	inline bool ws_utf8_valid(std::string_view data) {
+		return ws_utf8_valid(data.data(), data.size());
+	}
+
+	// 分片消息的增量校验: 每片调用feed, 最后一片之后调用finish
+	class ws_utf8_stream {
+	public:
+		// 返回false表示已经出现非法序列
+		inline bool feed(const char* data, std::size_t len) {
+			const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+			if (this->carry_len_ > 0) {
+				// 先补全上一片末尾的字符
+				std::size_t total = ws_utf8_detail::sequence_length(this->carry_[0]);
+				std::size_t need = total - this->carry_len_;
+				std::size_t n = (std::min)(need, len);
+				for (std::size_t i = 0; i < n; ++i) {
+					if ((s[i] & 0xC0) != 0x80)
+						return false;
+				}
+				std::memcpy(this->carry_ + this->carry_len_, s, n);
+				this->carry_len_ += n;
+				if (n < need)
+					return true;
+				s += n;
+				len -= n;
+				this->carry_len_ = 0;
+				if (!ws_utf8_detail::validate_scalar(this->carry_, total))
+					return false;
+			}
+			// 末尾不完整的字符留到下一片
+			std::size_t cut = len;
+			for (std::size_t k = 1; k <= 3 && k <= len; ++k) {
+				unsigned char c = s[len - k];
+				if (c < 0x80)
+					break;
+				if (c < 0xC0)	// 后续字节, 继续往前找开头
+					continue;
+				// 非法的开头字节不留, 由下面的校验报错
+				if (ws_utf8_detail::sequence_length(c) > k)
+					cut = len - k;
+				break;
+			}
+			if (!ws_utf8_valid(reinterpret_cast<const char*>(s), cut))
+				return false;
+			std::memcpy(this->carry_, s + cut, len - cut);
+			this->carry_len_ = len - cut;
+			return true;
+		}
+
+		inline bool feed(std::string_view data) { return this->feed(data.data(), data.size()); }
+
+		// 消息结束, 不能留有不完整的字符
+		inline bool finish() {
+			bool ok = this->carry_len_ == 0;
+			this->carry_len_ = 0;
+			return ok;
+		}
+
+		inline void reset() { this->carry_len_ = 0; }
+
+	private:
+		unsigned char carry_[4] = { 0 };
+		std::size_t carry_len_ = 0;
+	};
+}
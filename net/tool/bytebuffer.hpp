@@ -54,6 +54,12 @@ namespace net {
 			_currPtr += size;
 		}
 
+		// 保证可以写入size字节
+		inline bool wr_ensure(const unsigned int size) {
+			wr_reserve(size);
+			return true;
+		}
+
 		inline char *wr_buf() {
 			return &_buffer[_currPtr];
 		}
@@ -145,6 +151,17 @@ namespace net {
 			_currPtr += size;
 		}
 
+		// 保证可以写入size字节, 空间不足时先把未读数据移到头部, 仍然不足返回false
+		inline bool wr_ensure(const unsigned int size) {
+			if (wr_size() < size && _offPtr > 0) {
+				unsigned int tmp = _currPtr - _offPtr;
+				std::memmove(&_buffer[0], &_buffer[_offPtr], tmp);
+				_offPtr = 0;
+				_currPtr = tmp;
+			}
+			return wr_size() >= size;
+		}
+
 		inline char *wr_buf() {
 			return &_buffer[_currPtr];
 		}
@@ -3,6 +3,8 @@
 
 #include <unordered_map>
 #include <functional>
+
+#include "tool/logger.hpp"
 //#include <assert.h>
 
 namespace net {
@@ -429,7 +431,7 @@ namespace net {
 		template<class T>
 		inline bool bind_t(IDXTYPE evt, T&& fproxy) {
 			if (this->check(evt)) {
-				std::cout << " func is exist." << std::endl;
+				NET_LOG_WARN("func {} is exist", evt);
 				return false;
 			}
 			this->func_proxy_[evt] = std::unique_ptr<func_proxy_base>(new T(std::forward<T>(fproxy)));
@@ -0,0 +1,399 @@
+#pragma once
+
+/*
+* 异步日志：每个线程一个无锁单生产者环形队列, 后台线程统一取出、格式化并写出, io线程不碰stdout也不抢锁.
+* 记录时只拷贝格式串指针和参数值(字符串截断拷贝, error_code只存值和类别), 格式化(包括ec.message())在后台线程完成.
+* 格式串用{}占位, 必须是字面量(只保存指针).
+* 低于NET_LOG_LEVEL的NET_LOG_XXX宏在编译期展开为空, 参数不求值; 运行期可以用logger::instance().level()再调高.
+* 队列满时丢弃并计数, 不阻塞调用线程.
+*	NET_LOG_WARN("parse websocket error: {}", ec);
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "tool/noncopyable.hpp"
+
+#define NET_LOG_LEVEL_TRACE	0
+#define NET_LOG_LEVEL_DEBUG	1
+#define NET_LOG_LEVEL_INFO	2
+#define NET_LOG_LEVEL_WARN	3
+#define NET_LOG_LEVEL_ERROR	4
+#define NET_LOG_LEVEL_OFF	5
+
+#ifndef NET_LOG_LEVEL
+#define NET_LOG_LEVEL NET_LOG_LEVEL_INFO
+#endif
+
+// 每个线程的日志队列长度(条数, 2的幂)
+#ifndef NET_LOG_RING_SIZE
+#define NET_LOG_RING_SIZE 256
+#endif
+
+namespace net {
+	enum class log_level : std::uint8_t {
+		trace = NET_LOG_LEVEL_TRACE,
+		debug = NET_LOG_LEVEL_DEBUG,
+		info = NET_LOG_LEVEL_INFO,
+		warn = NET_LOG_LEVEL_WARN,
+		error = NET_LOG_LEVEL_ERROR,
+		off = NET_LOG_LEVEL_OFF,
+	};
+
+	struct log_arg {
+		enum type_t : std::uint8_t { i64, u64, f64, boolean, chr, ptr, str, err };
+		type_t type = i64;
+		std::uint16_t off = 0;	//str: 在log_record::text中的位置
+		std::uint16_t len = 0;
+		std::int32_t code = 0;	//err: error_code::value()
+		union {
+			std::int64_t i;
+			std::uint64_t u;
+			double d;
+			const void* p;
+			const std::error_category* cat;
+		};
+	};
+
+	struct log_record {
+		static constexpr std::size_t max_args = 12;
+		static constexpr std::size_t text_size = 256;
+
+		std::int64_t time_us = 0;
+		const char* fmt = nullptr;
+		log_level level = log_level::info;
+		std::uint8_t nargs = 0;
+		std::uint16_t text_len = 0;
+		log_arg args[max_args];
+		char text[text_size];
+
+		template<class T>
+		inline void capture(T&& value) {
+			using type = std::remove_cv_t<std::remove_reference_t<T>>;
+			log_arg& arg = this->args[this->nargs++];
+			if constexpr (std::is_same_v<type, bool>) {
+				arg.type = log_arg::boolean;
+				arg.u = value ? 1 : 0;
+			}
+			else if constexpr (std::is_same_v<type, char>) {
+				arg.type = log_arg::chr;
+				arg.u = static_cast<unsigned char>(value);
+			}
+			else if constexpr (std::is_enum_v<type>) {
+				arg.type = log_arg::i64;
+				arg.i = static_cast<std::int64_t>(value);
+			}
+			else if constexpr (std::is_integral_v<type> && std::is_signed_v<type>) {
+				arg.type = log_arg::i64;
+				arg.i = value;
+			}
+			else if constexpr (std::is_integral_v<type>) {
+				arg.type = log_arg::u64;
+				arg.u = value;
+			}
+			else if constexpr (std::is_floating_point_v<type>) {
+				arg.type = log_arg::f64;
+				arg.d = value;
+			}
+			else if constexpr (std::is_same_v<type, std::error_code>) {
+				arg.type = log_arg::err;
+				arg.code = value.value();
+				arg.cat = &value.category();
+			}
+			else if constexpr (std::is_convertible_v<const type&, std::string_view>) {
+				std::string_view sv(value);
+				std::size_t len = std::min(sv.size(), text_size - this->text_len);
+				std::memcpy(this->text + this->text_len, sv.data(), len);
+				arg.type = log_arg::str;
+				arg.off = this->text_len;
+				arg.len = static_cast<std::uint16_t>(len);
+				this->text_len += static_cast<std::uint16_t>(len);
+			}
+			else if constexpr (std::is_pointer_v<type>) {
+				arg.type = log_arg::ptr;
+				arg.p = static_cast<const void*>(value);
+			}
+			else {
+				static_assert(std::is_void_v<type> && !std::is_void_v<type>, "unsupported log argument type");
+			}
+		}
+
+		// 在后台线程格式化
+		inline void format(std::string& out) const {
+			static constexpr const char* level_name[] = { "TRACE", "DEBUG", "INFO ", "WARN ", "ERROR", "OFF  " };
+			std::time_t sec = static_cast<std::time_t>(this->time_us / 1000000);
+			std::tm tm{};
+#if defined(_WIN32) || defined(_WIN64)
+			localtime_s(&tm, &sec);
+#else
+			localtime_r(&sec, &tm);
+#endif
+			char buf[64];
+			std::size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+			n += std::snprintf(buf + n, sizeof(buf) - n, ".%03d [%s] ", static_cast<int>((this->time_us / 1000) % 1000),
+				level_name[static_cast<int>(this->level)]);
+			out.append(buf, n);
+
+			std::size_t next = 0;
+			for (const char* p = this->fmt; *p; ++p) {
+				if (p[0] == '{' && p[1] == '}' && next < this->nargs) {
+					this->append_arg(out, this->args[next++]);
+					++p;
+				}
+				else {
+					out.push_back(*p);
+				}
+			}
+			out.push_back('\n');
+		}
+
+	protected:
+		inline void append_arg(std::string& out, const log_arg& arg) const {
+			char buf[32];
+			int n = 0;
+			switch (arg.type) {
+			case log_arg::i64: n = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(arg.i)); break;
+			case log_arg::u64: n = std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(arg.u)); break;
+			case log_arg::f64: n = std::snprintf(buf, sizeof(buf), "%g", arg.d); break;
+			case log_arg::ptr: n = std::snprintf(buf, sizeof(buf), "%p", arg.p); break;
+			case log_arg::boolean: out.append(arg.u ? "true" : "false"); return;
+			case log_arg::chr: out.push_back(static_cast<char>(arg.u)); return;
+			case log_arg::str: out.append(this->text + arg.off, arg.len); return;
+			case log_arg::err: out.append(arg.cat->message(arg.code)); return;
+			}
+			out.append(buf, static_cast<std::size_t>(std::max(n, 0)));
+		}
+	};
+
+	// 单生产者单消费者: 生产者是所属线程, 消费者是日志线程. 直接在槽位上填写记录, 不额外拷贝.
+	class log_ring : private noncopyable {
+	public:
+		static constexpr std::size_t capacity = NET_LOG_RING_SIZE;
+		static_assert((capacity & (capacity - 1)) == 0, "NET_LOG_RING_SIZE must be a power of 2");
+
+		log_ring() : records_(new log_record[capacity]) {}
+
+		inline log_record* prepare() {
+			std::size_t tail = this->tail_.load(std::memory_order_relaxed);
+			if (tail - this->head_.load(std::memory_order_acquire) >= capacity) {
+				this->dropped_.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			return &this->records_[tail & (capacity - 1)];
+		}
+		inline void commit() {
+			this->tail_.store(this->tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		// 只能在日志线程调用
+		template<class Func>
+		inline std::size_t consume(Func&& func) {
+			std::size_t head = this->head_.load(std::memory_order_relaxed);
+			std::size_t tail = this->tail_.load(std::memory_order_acquire);
+			for (std::size_t i = head; i != tail; ++i) {
+				func(this->records_[i & (capacity - 1)]);
+			}
+			this->head_.store(tail, std::memory_order_release);
+			return tail - head;
+		}
+
+		inline bool empty() const {
+			return this->head_.load(std::memory_order_acquire) == this->tail_.load(std::memory_order_acquire);
+		}
+		inline std::size_t take_dropped() { return this->dropped_.exchange(0, std::memory_order_relaxed); }
+
+		std::atomic<bool> closed{ false };
+
+	protected:
+		std::unique_ptr<log_record[]> records_;
+		alignas(64) std::atomic<std::size_t> tail_{ 0 };
+		alignas(64) std::atomic<std::size_t> head_{ 0 };
+		std::atomic<std::size_t> dropped_{ 0 };
+	};
+
+	class logger : private noncopyable {
+	public:
+		using sink_type = std::function<void(std::string_view)>;
+
+		static inline logger& instance() {
+			static logger inst;
+			return inst;
+		}
+
+		~logger() {
+			this->stop();
+		}
+
+		inline log_level level() const { return this->level_.load(std::memory_order_relaxed); }
+		inline void level(log_level lv) { this->level_.store(lv, std::memory_order_relaxed); }
+
+		// 默认写stderr; 回调在日志线程中执行, 每次传入一批格式化好的行
+		inline void sink(sink_type func) {
+			std::lock_guard<std::mutex> lock(this->sink_mutex_);
+			this->sink_ = std::move(func);
+		}
+
+		// 等待之前的日志全部写出
+		inline void flush() {
+			if (!this->running_.load(std::memory_order_acquire))
+				return;
+			std::size_t gen = this->flush_req_.fetch_add(1, std::memory_order_acq_rel) + 1;
+			while (this->flush_done_.load(std::memory_order_acquire) < gen && this->running_.load(std::memory_order_acquire)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		inline void stop() {
+			if (!this->running_.exchange(false))
+				return;
+			if (this->thread_.joinable())
+				this->thread_.join();
+			this->drain();
+		}
+
+		inline log_ring& local_ring() {
+			struct holder {
+				std::shared_ptr<log_ring> ring;
+				~holder() { if (ring) ring->closed.store(true, std::memory_order_release); }
+			};
+			thread_local holder h;
+			if (!h.ring) {
+				h.ring = std::make_shared<log_ring>();
+				this->attach(h.ring);
+			}
+			return *h.ring;
+		}
+
+	protected:
+		logger() = default;
+
+		inline void attach(std::shared_ptr<log_ring> ring) {
+			std::lock_guard<std::mutex> lock(this->rings_mutex_);
+			this->rings_.emplace_back(std::move(ring));
+			if (!this->running_.exchange(true)) {
+				this->thread_ = std::thread([this]() { this->run(); });
+			}
+		}
+
+		inline void run() {
+			int idle = 0;
+			while (this->running_.load(std::memory_order_acquire)) {
+				std::size_t gen = this->flush_req_.load(std::memory_order_acquire);
+				if (this->drain() > 0) {
+					idle = 0;
+				}
+				else {
+					// 空闲时逐步退避, 最长16ms
+					std::this_thread::sleep_for(std::chrono::milliseconds(1 << std::min(idle++, 4)));
+				}
+				this->flush_done_.store(gen, std::memory_order_release);
+			}
+		}
+
+		inline std::size_t drain() {
+			std::size_t count = 0;
+			std::size_t dropped = 0;
+			this->line_.clear();
+			{
+				std::lock_guard<std::mutex> lock(this->rings_mutex_);
+				for (auto itr = this->rings_.begin(); itr != this->rings_.end();) {
+					auto& ring = *itr;
+					bool closed = ring->closed.load(std::memory_order_acquire);
+					count += ring->consume([this](const log_record& r) { r.format(this->line_); });
+					dropped += ring->take_dropped();
+					itr = closed ? this->rings_.erase(itr) : itr + 1;
+				}
+			}
+			if (dropped > 0) {
+				this->line_.append("[net log] ").append(std::to_string(dropped)).append(" records dropped\n");
+			}
+			if (!this->line_.empty()) {
+				std::lock_guard<std::mutex> lock(this->sink_mutex_);
+				if (this->sink_) {
+					this->sink_(this->line_);
+				}
+				else {
+					std::fwrite(this->line_.data(), 1, this->line_.size(), stderr);
+					std::fflush(stderr);
+				}
+			}
+			return count;
+		}
+
+	protected:
+		std::atomic<log_level> level_{ static_cast<log_level>(NET_LOG_LEVEL) };
+		std::atomic<bool> running_{ false };
+		std::atomic<std::size_t> flush_req_{ 0 };
+		std::atomic<std::size_t> flush_done_{ 0 };
+		std::thread thread_;
+		std::mutex rings_mutex_;
+		std::vector<std::shared_ptr<log_ring>> rings_;
+		std::mutex sink_mutex_;
+		sink_type sink_;
+		std::string line_;
+	};
+
+	template<class ...Args>
+	inline void log_write(log_level level, const char* fmt, Args&&... args) {
+		static_assert(sizeof...(Args) <= log_record::max_args, "too many log arguments");
+		logger& lg = logger::instance();
+		if (level < lg.level())
+			return;
+		log_ring& ring = lg.local_ring();
+		log_record* r = ring.prepare();
+		if (!r)
+			return;
+		r->time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		r->fmt = fmt;
+		r->level = level;
+		r->nargs = 0;
+		r->text_len = 0;
+		(r->capture(std::forward<Args>(args)), ...);
+		ring.commit();
+	}
+}
+
+#if NET_LOG_LEVEL <= NET_LOG_LEVEL_TRACE
+#define NET_LOG_TRACE(...) ::net::log_write(::net::log_level::trace, __VA_ARGS__)
+#else
+#define NET_LOG_TRACE(...) ((void)0)
+#endif
+
+#if NET_LOG_LEVEL <= NET_LOG_LEVEL_DEBUG
+#define NET_LOG_DEBUG(...) ::net::log_write(::net::log_level::debug, __VA_ARGS__)
+#else
+#define NET_LOG_DEBUG(...) ((void)0)
+#endif
+
+#if NET_LOG_LEVEL <= NET_LOG_LEVEL_INFO
+#define NET_LOG_INFO(...) ::net::log_write(::net::log_level::info, __VA_ARGS__)
+#else
+#define NET_LOG_INFO(...) ((void)0)
+#endif
+
+#if NET_LOG_LEVEL <= NET_LOG_LEVEL_WARN
+#define NET_LOG_WARN(...) ::net::log_write(::net::log_level::warn, __VA_ARGS__)
+#else
+#define NET_LOG_WARN(...) ((void)0)
+#endif
+
+#if NET_LOG_LEVEL <= NET_LOG_LEVEL_ERROR
+#define NET_LOG_ERROR(...) ::net::log_write(::net::log_level::error, __VA_ARGS__)
+#else
+#define NET_LOG_ERROR(...) ((void)0)
+#endif
@@ -0,0 +1,209 @@
+#pragma once
+
+/*
+* 镜像环形缓冲区：同一块物理内存(memfd)在虚拟地址上连续映射两次, [base, base+cap)和[base+cap, base+2cap)指向同一份数据.
+* 读写位置只增不减, 任意位置开始的可读/可写区间在地址上都是连续的, 不需要memmove整理, 也不需要在边界处拆成两段.
+* 只有需要的空间超过容量时才扩容(容量翻倍, 拷贝一次未读数据). 长度均为std::size_t.
+* 非linux或者映射失败时退化为普通线性缓存(空间不足时整理/扩容), 接口不变.
+* 接口与bytebuffer一致, 可以替换t_buffer_cmdqueue作为接收缓存(见default_traits::use_mirror_buffer).
+*/
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "tool/noncopyable.hpp"
+
+namespace net {
+	class mirror_buffer : private noncopyable {
+	public:
+		static constexpr std::size_t default_size = 64 * 1024;
+
+		explicit mirror_buffer(std::size_t size = default_size) {
+			this->allocate(size);
+		}
+		~mirror_buffer() {
+			this->release();
+		}
+		mirror_buffer(mirror_buffer&& other) noexcept { this->swap(other); }
+		mirror_buffer& operator=(mirror_buffer&& other) noexcept {
+			if (this != &other) {
+				this->release();
+				this->swap(other);
+			}
+			return *this;
+		}
+
+		inline void wr_reserve(const std::size_t size) {
+			if (this->wr_size() >= size)
+				return;
+			if (!this->mirrored_ && this->rd_ > 0 && this->capacity_ - this->rd_size() >= size) {
+				// 线性模式：先把未读数据移到头部
+				std::size_t len = this->rd_size();
+				std::memmove(this->base_, this->base_ + this->rd_, len);
+				this->rd_ = 0;
+				this->wr_ = len;
+				return;
+			}
+			this->grow(this->rd_size() + size);
+		}
+
+		// 保证可以写入size字节
+		inline bool wr_ensure(const std::size_t size) {
+			this->wr_reserve(size);
+			return this->wr_size() >= size;
+		}
+
+		inline void put(const char* buf, const std::size_t size) {
+			this->wr_reserve(size);
+			std::memcpy(this->wr_buf(), buf, size);
+			this->wr_ += size;
+		}
+
+		inline char* wr_buf() { return this->base_ + this->offset(this->wr_); }
+		inline const char* rd_buf() const { return this->base_ + this->offset(this->rd_); }
+
+		inline bool rd_ready() const { return this->wr_ > this->rd_; }
+		inline std::size_t rd_size() const { return static_cast<std::size_t>(this->wr_ - this->rd_); }
+
+		inline void rd_flip(std::size_t size) {
+			this->rd_ += size;
+			if (this->rd_ >= this->wr_) {
+				this->rd_ = 0;
+				this->wr_ = 0;
+			}
+		}
+
+		// 可以连续写入的字节数
+		inline std::size_t wr_size() const {
+			if (this->mirrored_)
+				return this->capacity_ - this->rd_size();
+			return this->capacity_ - static_cast<std::size_t>(this->wr_);
+		}
+		inline void wr_flip(const std::size_t size) { this->wr_ += size; }
+
+		inline void reset() {
+			this->rd_ = 0;
+			this->wr_ = 0;
+		}
+
+		inline std::size_t maxSize() const { return this->capacity_; }
+		inline bool is_mirrored() const { return this->mirrored_; }
+
+		inline bool is_range(void* pointer) {
+			char* p = static_cast<char*>(pointer);
+			return p >= this->base_ && p <= this->base_ + (this->mirrored_ ? 2 * this->capacity_ : this->capacity_);
+		}
+
+	protected:
+		inline std::size_t offset(std::uint64_t pos) const {
+			return this->mirrored_ ? static_cast<std::size_t>(pos & (this->capacity_ - 1)) : static_cast<std::size_t>(pos);
+		}
+
+		static inline std::size_t round_size(std::size_t size) {
+			std::size_t cap = 4096;
+#if defined(__linux__)
+			cap = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+			while (cap < size)
+				cap <<= 1;
+			return cap;
+		}
+
+		inline void allocate(std::size_t size) {
+			std::size_t cap = round_size(size);
+#if defined(__linux__)
+			if (this->map_mirror(cap))
+				return;
+#endif
+			this->heap_.resize(cap);
+			this->base_ = this->heap_.data();
+			this->capacity_ = cap;
+			this->mirrored_ = false;
+		}
+
+#if defined(__linux__)
+		inline bool map_mirror(std::size_t cap) {
+			int fd = ::memfd_create("net_mirror_buffer", MFD_CLOEXEC);
+			if (fd < 0)
+				return false;
+			char* addr = nullptr;
+			if (::ftruncate(fd, static_cast<off_t>(cap)) == 0) {
+				void* area = ::mmap(nullptr, 2 * cap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (area != MAP_FAILED) {
+					addr = static_cast<char*>(area);
+					if (::mmap(addr, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+						::mmap(addr + cap, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+						::munmap(addr, 2 * cap);
+						addr = nullptr;
+					}
+				}
+			}
+			//映射建立后不再需要fd, 不占用进程的文件描述符
+			::close(fd);
+			if (!addr)
+				return false;
+			this->base_ = addr;
+			this->capacity_ = cap;
+			this->mirrored_ = true;
+			return true;
+		}
+#endif
+
+		inline void release() {
+#if defined(__linux__)
+			if (this->mirrored_ && this->base_)
+				::munmap(this->base_, 2 * this->capacity_);
+#endif
+			std::vector<char>().swap(this->heap_);
+			this->base_ = nullptr;
+			this->capacity_ = 0;
+			this->mirrored_ = false;
+			this->rd_ = 0;
+			this->wr_ = 0;
+		}
+
+		inline void grow(std::size_t size) {
+			mirror_buffer tmp(std::max(size, this->capacity_ * 2));
+			std::size_t len = this->rd_size();
+			if (len > 0)
+				std::memcpy(tmp.base_, this->rd_buf(), len);
+			tmp.wr_ = len;
+			this->release();
+			this->swap(tmp);
+		}
+
+		inline void swap(mirror_buffer& other) noexcept {
+			std::swap(this->base_, other.base_);
+			std::swap(this->capacity_, other.capacity_);
+			std::swap(this->mirrored_, other.mirrored_);
+			std::swap(this->rd_, other.rd_);
+			std::swap(this->wr_, other.wr_);
+			this->heap_.swap(other.heap_);
+		}
+
+	protected:
+		char* base_ = nullptr;
+		std::size_t capacity_ = 0;
+		bool mirrored_ = false;
+		std::uint64_t rd_ = 0;
+		std::uint64_t wr_ = 0;
+		std::vector<char> heap_;
+	};
+
+	// 以镜像映射分配的接收缓存, initlen为初始容量
+	template<std::size_t initlen = mirror_buffer::default_size>
+	class t_mirror_cmdqueue : public mirror_buffer {
+	public:
+		t_mirror_cmdqueue() : mirror_buffer(initlen) {}
+		~t_mirror_cmdqueue() = default;
+	};
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+#include "tool/noncopyable.hpp"
+
+namespace net {
+	// 有界无锁环形队列：多生产者单消费者(Dmitry Vyukov bounded queue), 容量向上取2的幂.
+	// 每个槽位带一个序号, 生产者用cas抢占写位置, 消费者不需要原子操作抢占读位置.
+	template<class T>
+	class mpsc_ring : private noncopyable {
+	public:
+		explicit mpsc_ring(std::size_t capacity = 65536) {
+			std::size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+			this->mask_ = size - 1;
+			this->cells_ = std::unique_ptr<cell[]>(new cell[size]);
+			for (std::size_t i = 0; i < size; ++i) {
+				this->cells_[i].seq.store(i, std::memory_order_relaxed);
+			}
+		}
+		~mpsc_ring() = default;
+
+		// 队列满时返回false, 失败时不会移走value.
+		template<class U>
+		inline bool try_push(U&& value) {
+			cell* c = nullptr;
+			std::size_t pos = this->tail_.load(std::memory_order_relaxed);
+			for (;;) {
+				c = &this->cells_[pos & this->mask_];
+				std::size_t seq = c->seq.load(std::memory_order_acquire);
+				std::intptr_t dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+				if (dif == 0) {
+					if (this->tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (dif < 0) {
+					this->full_count_.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				else
+					pos = this->tail_.load(std::memory_order_relaxed);
+			}
+			c->value = std::forward<U>(value);
+			c->seq.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// 只能在消费者线程调用.
+		inline bool pop(T& value) {
+			cell* c = &this->cells_[this->head_ & this->mask_];
+			std::size_t seq = c->seq.load(std::memory_order_acquire);
+			if (static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(this->head_ + 1) < 0)
+				return false;
+			value = std::move(c->value);
+			c->value = T();
+			c->seq.store(this->head_ + this->mask_ + 1, std::memory_order_release);
+			++this->head_;
+			return true;
+		}
+
+		inline std::size_t capacity() const { return this->mask_ + 1; }
+		// try_push因队列满失败的次数
+		inline std::size_t full_count() const { return this->full_count_.load(std::memory_order_relaxed); }
+
+		inline bool empty() const {
+			return this->tail_.load(std::memory_order_acquire) == this->head_;
+		}
+
+	protected:
+		struct cell {
+			std::atomic<std::size_t> seq{ 0 };
+			T value;
+		};
+
+		std::unique_ptr<cell[]> cells_;
+		std::size_t mask_ = 0;
+		alignas(64) std::atomic<std::size_t> tail_{ 0 };
+		alignas(64) std::size_t head_ = 0;
+		std::atomic<std::size_t> full_count_{ 0 };
+	};
+}
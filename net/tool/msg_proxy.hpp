@@ -1,8 +1,13 @@
 #pragma once
 
+#include <memory>
+#include <cstring>
 #include <unordered_map>
 
 #include "help_type.hpp"
+#include "logger.hpp"
+#include "pb_arena.hpp"
+#include "perfect_hash.hpp"
 
 namespace net {
 	struct check_struct_memfns_base {
@@ -39,6 +44,22 @@ namespace net {
 	constexpr bool is_pb_proto_v = is_pb_proto<unqualified_t<T>>::value;
 	template<typename T>
 	constexpr bool is_struct_proto_v = std::is_pod<unqualified_t<T>>::value;
+	// 可以直接在接收缓存上引用的struct协议：可平凡拷贝且内存布局固定
+	template<typename T>
+	constexpr bool is_view_proto_v = std::is_trivially_copyable_v<unqualified_t<T>> && std::is_standard_layout_v<unqualified_t<T>>;
+
+	// struct协议解析：长度必须等于sizeof(T), memcpy到栈上再交给处理函数(接收缓存里没有T对象, 不能直接引用);
+	// 处理函数参数可以是const T&, T&或者值类型. 小的可平凡拷贝结构体编译后是几条load.
+	template<class T, class Fn>
+	inline bool struct_view(const char* buf, std::size_t len, Fn&& fn) {
+		static_assert(is_view_proto_v<T>, "struct packet must be trivially copyable and standard layout");
+		if (len != sizeof(T))
+			return false;
+		T pcg;
+		std::memcpy(&pcg, buf, sizeof(T));
+		fn(pcg);
+		return true;
+	}
 
 
 	class msg_func_proxy_base {
@@ -67,60 +88,57 @@ namespace net {
 
 		template<class F, class Packet>
 		inline void bind(F&& f, Packet&& pcg) {
-			this->fn_ = [this, fn = std::forward<F>(f), pcg = std::move(pcg)](const char* buf, std::size_t len, Args&&... args) mutable {
-				using PacketType = unqualified_t<Packet>;
-				if constexpr (is_pb_proto_v<PacketType>) { //pb 协议解析
-					if (pcg.ParseFromArray(buf, len)) {
+			using PacketType = unqualified_t<Packet>;
+			if constexpr (is_pb_proto_v<PacketType>) { //pb 协议解析
+				this->fn_ = [this, fn = std::forward<F>(f)](const char* buf, std::size_t len, Args&&... args) mutable {
+					pb_parse<PacketType>(buf, len, [&](PacketType& pcg) {
 						fn(pcg, std::forward<Args>(args)...);
-					}
-					return;
-				}
-				else /*if constexpr (is_struct_proto_v<PacketType>)*/ { //默认struct 协议解析
-					if (len == sizeof(PacketType)) {
-						pcg = *(PacketType*)buf;
+					});
+				};
+			}
+			else { //默认struct 协议解析
+				this->fn_ = [this, fn = std::forward<F>(f)](const char* buf, std::size_t len, Args&&... args) mutable {
+					struct_view<PacketType>(buf, len, [&](auto& pcg) {
 						fn(pcg, std::forward<Args>(args)...);
-					}
-					return;
-				}
-			};
+					});
+				};
+			}
 		}
 
 		template<class F, class Packet, class C>
 		inline void bind(F&& f, Packet&& pcg, C&& c) {
 			using PacketType = unqualified_t<Packet>;
 			if constexpr (std::is_pointer_v<std::decay_t<C>> || is_shared_ptr_v<std::decay_t<C>>) {
-				this->fn_ = [this, fn = std::forward<F>(f), pcg = std::move(pcg), s = std::forward<C>(c)](const char* buf, std::size_t len, Args&&... args) mutable {
-					if constexpr (is_pb_proto_v<PacketType>) { //pb 协议解析
-						if (pcg.ParseFromArray(buf, len)) {
+				if constexpr (is_pb_proto_v<PacketType>) { //pb 协议解析
+					this->fn_ = [this, fn = std::forward<F>(f), s = std::forward<C>(c)](const char* buf, std::size_t len, Args&&... args) mutable {
+						pb_parse<PacketType>(buf, len, [&](PacketType& pcg) {
 							((*s).*fn)(pcg, std::forward<Args>(args)...);
-						}
-						return;
-					}
-					else /*if constexpr (is_struct_proto_v<PacketType>)*/ { //默认struct 协议解析
-						if (len == sizeof(PacketType)) {
-							pcg = *(PacketType*)buf;
+						});
+					};
+				}
+				else { //默认struct 协议解析
+					this->fn_ = [this, fn = std::forward<F>(f), s = std::forward<C>(c)](const char* buf, std::size_t len, Args&&... args) mutable {
+						struct_view<PacketType>(buf, len, [&](auto& pcg) {
 							((*s).*fn)(pcg, std::forward<Args>(args)...);
-						}
-						return;
-					}
-				};
+						});
+					};
+				}
 			}
 			else {
-				this->fn_ = [this, fn = std::forward<F>(f), pcg = std::move(pcg), s = std::forward<C>(c)](const char* buf, std::size_t len, Args&&... args) mutable {
-					if constexpr (is_pb_proto_v<PacketType>) { //pb 协议解析
-						if (pcg.ParseFromArray(buf, len)) {
+				if constexpr (is_pb_proto_v<PacketType>) { //pb 协议解析
+					this->fn_ = [this, fn = std::forward<F>(f), s = std::forward<C>(c)](const char* buf, std::size_t len, Args&&... args) mutable {
+						pb_parse<PacketType>(buf, len, [&](PacketType& pcg) {
 							(s.*fn)(pcg, std::forward<Args>(args)...);
-						}
-						return;
-					}
-					else /*if constexpr (is_struct_proto_v<PacketType>)*/ { //默认struct 协议解析
-						if (len == sizeof(PacketType)) {
-							pcg = *(PacketType*)buf;
+						});
+					};
+				}
+				else { //默认struct 协议解析
+					this->fn_ = [this, fn = std::forward<F>(f), s = std::forward<C>(c)](const char* buf, std::size_t len, Args&&... args) mutable {
+						struct_view<PacketType>(buf, len, [&](auto& pcg) {
 							(s.*fn)(pcg, std::forward<Args>(args)...);
-						}
-						return;
-					}
-				};
+						});
+					};
+				}
 			}
 		}
 
@@ -139,18 +157,34 @@ namespace net {
 	template<typename IDXTYPE>
 	class msg_func_proxy_imp {
 	public:
-		template<class... Args>
-		inline bool call(IDXTYPE evt, const char* buf, std::size_t len, Args&&... args) {
-			if (!this->check(evt)) {
+		// 字符串id可以直接传入string_view/const char*, 冻结后不再构造std::string.
+		template<class KEY, class... Args>
+		inline bool call(KEY&& evt, const char* buf, std::size_t len, Args&&... args) {
+			msg_func_proxy_base* base = this->find(evt);
+			if (!base) {
 				return false;
 			}
 			using func_proxy_type = msg_func_proxy<Args...>;
-			func_proxy_type* fp_ptr = static_cast<func_proxy_type*>(this->func_proxy_[evt].get());
-			if (fp_ptr) {
-				(*fp_ptr)(buf, len, std::forward<Args>(args)...);
+			(*static_cast<func_proxy_type*>(base))(buf, len, std::forward<Args>(args)...);
+			return true;
+		}
+
+		// 字符串id注册完成后调用：构建最小完美哈希, 查找只需一次哈希和一次比较. 冻结后不能再注册.
+		inline bool freeze() {
+			static_assert(std::is_same_v<unqualified_t<IDXTYPE>, std::string>, "freeze only for string ids");
+			std::vector<std::pair<std::string, msg_func_proxy_base*>> items;
+			items.reserve(this->func_proxy_.size());
+			for (auto& item : this->func_proxy_) {
+				items.emplace_back(item.first, item.second.get());
+			}
+			this->frozen_ = std::make_unique<frozen_str_map<msg_func_proxy_base*>>();
+			if (!this->frozen_->build(std::move(items))) {
+				this->frozen_.reset();
+				return false;
 			}
 			return true;
 		}
+		inline bool is_frozen() const { return static_cast<bool>(this->frozen_); }
 
 		inline bool check(IDXTYPE evt) {
 			//return this->func_proxy_[evt];
@@ -195,10 +229,31 @@ namespace net {
 			return this->bind_t(evt, msg_func_proxy<Args...>(f, pcg, c));
 		}
 	protected:
+		template<class KEY>
+		inline msg_func_proxy_base* find(const KEY& evt) {
+			if constexpr (std::is_same_v<unqualified_t<IDXTYPE>, std::string>) {
+				std::string_view key(evt);
+				if (this->frozen_) {
+					auto base = this->frozen_->find(key);
+					return base ? *base : nullptr;
+				}
+				const auto& item = this->func_proxy_.find(std::string(key));
+				return (item != this->func_proxy_.end()) ? item->second.get() : nullptr;
+			}
+			else {
+				const auto& item = this->func_proxy_.find(evt);
+				return (item != this->func_proxy_.end()) ? item->second.get() : nullptr;
+			}
+		}
+
 		template<class T>
 		inline bool bind_t(IDXTYPE evt, T&& fproxy) {
+			if (this->frozen_) {
+				NET_LOG_WARN("msg proxy is frozen, bind {} failed", evt);
+				return false;
+			}
 			if (this->check(evt)) {
-				std::cout << " func is exist." << std::endl;
+				NET_LOG_WARN("msg func {} is exist", evt);
 				return false;
 			}
 			this->func_proxy_[evt] = std::unique_ptr<msg_func_proxy_base>(new T(std::forward<T>(fproxy)));
@@ -206,6 +261,7 @@ namespace net {
 		}
 
 		std::unordered_map<unqualified_t<IDXTYPE>, std::unique_ptr<msg_func_proxy_base>> func_proxy_;
+		std::unique_ptr<frozen_str_map<msg_func_proxy_base*>> frozen_;
 	};
 	using MSGIDPROXYTYPE = msg_func_proxy_imp<int32_t>;
 	typedef std::shared_ptr<MSGIDPROXYTYPE> MsgIdFuncProxyImpPtr;
@@ -0,0 +1,238 @@
+#pragma once
+
+/*
+* 消息路由：挂在server/client的接收流程上, 直接从session的接收缓存中按帧解析并派发.
+* 帧格式：[len:uint32][msg_id:uint32][body:len], 头部为网络字节序, len为body长度.
+* msg_id作为下标存放在连续数组中, 一次读取到的多个完整帧在同一批次内派发完, 不完整的帧留在缓存中.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "base/error.hpp"
+#include "tool/help_type.hpp"
+#include "tool/msg_proxy.hpp"
+#include "tool/bytebuffer.hpp"
+
+namespace net {
+	// 每个消息id的统计, 在io线程中累加, 可以在任意线程读取.
+	struct msg_stats {
+		std::atomic<std::uint64_t> count{ 0 };
+		std::atomic<std::uint64_t> bytes{ 0 };
+		std::atomic<std::uint64_t> errors{ 0 };	//解码失败
+		std::atomic<std::uint64_t> total_ns{ 0 };	//处理耗时, 开启latency时统计
+		std::atomic<std::uint64_t> max_ns{ 0 };
+	};
+
+	// 推导处理函数的消息类型：f(session, Packet)
+	template<class T>
+	struct router_fn_traits : router_fn_traits<decltype(&T::operator())> {};
+	template<class Ret, class S, class P>
+	struct router_fn_traits<Ret(*)(S, P)> { using packet_type = unqualified_t<P>; };
+	template<class Ret, class C, class S, class P>
+	struct router_fn_traits<Ret(C::*)(S, P)> { using packet_type = unqualified_t<P>; };
+	template<class Ret, class C, class S, class P>
+	struct router_fn_traits<Ret(C::*)(S, P) const> { using packet_type = unqualified_t<P>; };
+
+	template<class SESSIONPTR>
+	class msg_router : private noncopyable {
+	public:
+		using handler_type = std::function<bool(SESSIONPTR&, const char*, std::size_t)>;
+		using default_handler_type = std::function<void(SESSIONPTR&, std::uint32_t, std::string_view)>;
+		static constexpr std::size_t header_size = 8;
+		static constexpr std::uint32_t max_msg_id = 0xFFFF;
+
+	public:
+		msg_router() = default;
+		~msg_router() = default;
+
+		// 注册消息处理, 需在start之前调用. 处理函数原型：
+		//	f(session_ptr&, std::string_view body)	原始数据
+		//	f(session_ptr&, const Packet&)			pb或者struct协议, pb在栈上或者arena上解码, struct拷贝到栈上
+		template<class F>
+		inline bool bind(std::uint32_t id, F&& f) {
+			using fn_type = std::decay_t<F>;
+			if constexpr (std::is_invocable_v<fn_type&, SESSIONPTR&, std::string_view>) {
+				return this->bind_t(id, [fn = std::forward<F>(f)](SESSIONPTR& session, const char* buf, std::size_t len) mutable {
+					fn(session, std::string_view(buf, len));
+					return true;
+				});
+			}
+			else {
+				using packet_type = typename router_fn_traits<fn_type>::packet_type;
+				return this->bind_t(id, [fn = std::forward<F>(f)](SESSIONPTR& session, const char* buf, std::size_t len) mutable {
+					return decode<packet_type>(buf, len, [&fn, &session](auto& pcg) {
+						fn(session, pcg);
+					});
+				});
+			}
+		}
+		// 类成员函数, c可以为引用, 指针或者智能指针
+		template<class Ret, class C, class S, class P, class T>
+		inline bool bind(std::uint32_t id, Ret(C::* f)(S, P), T&& c) {
+			if constexpr (std::is_pointer_v<std::decay_t<T>> || is_shared_ptr_v<std::decay_t<T>>) {
+				CHECK_POINT(c);
+				return this->bind(id, [f, s = std::forward<T>(c)](SESSIONPTR& session, P pcg) mutable {
+					((*s).*f)(session, std::forward<P>(pcg));
+				});
+			}
+			else {
+				return this->bind(id, [f, s = std::forward<T>(c)](SESSIONPTR& session, P pcg) mutable {
+					(s.*f)(session, std::forward<P>(pcg));
+				});
+			}
+		}
+
+		// 未注册的消息id
+		inline void bind_default(default_handler_type fn) { this->default_ = std::move(fn); }
+
+		// 单帧body最大长度, 超过时断开连接.
+		inline void max_body_size(std::size_t size) { this->max_body_ = size; }
+		// 统计每个消息的处理耗时
+		inline void latency(bool enable) { this->latency_ = enable; }
+
+		// 派发新收到的数据, 优先直接在data上解析, 不完整的尾部才拷贝到buffer中.
+		// 返回false表示帧长度非法或者缓存放不下, 调用方需断开连接.
+		template<class BUFFER>
+		inline bool dispatch(SESSIONPTR& session, BUFFER& buffer, const char* data, std::size_t size) {
+#if defined(NET_PROTOBUF_ARENA_BATCH)
+			pb_arena_scope arena_scope;
+#endif
+			std::size_t used = 0;
+			if (buffer.rd_size() == 0) {
+				if (!this->dispatch_frames(session, data, size, used))
+					return false;
+				if (used < size) {
+					if (!buffer.wr_ensure(static_cast<unsigned int>(size - used)))
+						return false;
+					buffer.put(data + used, static_cast<unsigned int>(size - used));
+				}
+				return true;
+			}
+			if (!buffer.wr_ensure(static_cast<unsigned int>(size)))
+				return false;
+			buffer.put(data, static_cast<unsigned int>(size));
+			bool ret = this->dispatch_frames(session, buffer.rd_buf(), buffer.rd_size(), used);
+			buffer.rd_flip(static_cast<unsigned int>(used));
+			return ret;
+		}
+
+		// 打包一帧, 用于发送
+		static inline std::string pack(std::uint32_t id, std::string_view body) {
+			std::string frame(header_size + body.size(), '\0');
+			write_be32(&frame[0], static_cast<std::uint32_t>(body.size()));
+			write_be32(&frame[4], id);
+			if (!body.empty())
+				std::memcpy(&frame[header_size], body.data(), body.size());
+			return frame;
+		}
+
+		inline const msg_stats* stats(std::uint32_t id) const {
+			return (id < this->routes_.size() && this->routes_[id]) ? &this->routes_[id]->stats : nullptr;
+		}
+		template<class Fn>
+		inline void foreach_stats(Fn&& fn) const {
+			for (std::size_t id = 0; id < this->routes_.size(); ++id) {
+				if (this->routes_[id])
+					fn(static_cast<std::uint32_t>(id), this->routes_[id]->stats);
+			}
+		}
+		inline std::uint64_t unknown_count() const { return this->unknown_.load(std::memory_order_relaxed); }
+
+	protected:
+		struct route {
+			handler_type fn;
+			msg_stats stats;
+		};
+
+		template<class Packet, class Fn>
+		static inline bool decode(const char* buf, std::size_t len, Fn&& fn) {
+			if constexpr (is_pb_proto_v<Packet>) { //pb 协议解析, 见pb_arena.hpp
+				return pb_parse<Packet>(buf, len, std::forward<Fn>(fn));
+			}
+			else { //默认struct 协议解析, 拷贝到栈上
+				return struct_view<Packet>(buf, len, std::forward<Fn>(fn));
+			}
+		}
+
+		inline bool bind_t(std::uint32_t id, handler_type&& fn) {
+			if (id > max_msg_id) {
+				set_last_error(asio::error::invalid_argument);
+				return false;
+			}
+			if (id >= this->routes_.size())
+				this->routes_.resize(id + 1);
+			if (this->routes_[id]) {
+				set_last_error(asio::error::already_open);
+				return false;
+			}
+			this->routes_[id] = std::make_unique<route>();
+			this->routes_[id]->fn = std::move(fn);
+			return true;
+		}
+
+		inline bool dispatch_frames(SESSIONPTR& session, const char* data, std::size_t size, std::size_t& used) {
+			while (size - used >= header_size) {
+				const char* frame = data + used;
+				std::uint32_t len = read_be32(frame);
+				if (len > this->max_body_)
+					return false;
+				if (size - used - header_size < len)
+					break;
+				this->invoke(session, read_be32(frame + 4), frame + header_size, len);
+				used += header_size + len;
+			}
+			return true;
+		}
+
+		inline void invoke(SESSIONPTR& session, std::uint32_t id, const char* body, std::size_t len) {
+			route* r = (id < this->routes_.size() ? this->routes_[id].get() : nullptr);
+			if (!r) {
+				this->unknown_.fetch_add(1, std::memory_order_relaxed);
+				if (this->default_)
+					this->default_(session, id, std::string_view(body, len));
+				return;
+			}
+			r->stats.count.fetch_add(1, std::memory_order_relaxed);
+			r->stats.bytes.fetch_add(len, std::memory_order_relaxed);
+			if (!this->latency_) {
+				if (!r->fn(session, body, len))
+					r->stats.errors.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			auto t1 = std::chrono::steady_clock::now();
+			if (!r->fn(session, body, len))
+				r->stats.errors.fetch_add(1, std::memory_order_relaxed);
+			std::uint64_t ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - t1).count());
+			r->stats.total_ns.fetch_add(ns, std::memory_order_relaxed);
+			std::uint64_t max = r->stats.max_ns.load(std::memory_order_relaxed);
+			while (ns > max && !r->stats.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+		}
+
+		static inline std::uint32_t read_be32(const char* p) {
+			const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+			return (std::uint32_t(u[0]) << 24) | (std::uint32_t(u[1]) << 16) | (std::uint32_t(u[2]) << 8) | std::uint32_t(u[3]);
+		}
+		static inline void write_be32(char* p, std::uint32_t v) {
+			p[0] = static_cast<char>(v >> 24);
+			p[1] = static_cast<char>(v >> 16);
+			p[2] = static_cast<char>(v >> 8);
+			p[3] = static_cast<char>(v);
+		}
+
+	protected:
+		std::vector<std::unique_ptr<route>> routes_;
+		default_handler_type default_;
+		std::atomic<std::uint64_t> unknown_{ 0 };
+		std::size_t max_body_ = 16 * 1024 * 1024;
+		bool latency_ = false;
+	};
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+* pb协议解析：
+* NET_USE_PROTOBUF_ARENA  每个线程一个arena, 消息在arena上解析, handler返回后arena整体重置, 不逐个释放子对象.
+* NET_PROTOBUF_ARENA_BATCH 同一批次的多个帧共用arena, 批次结束才重置(见pb_arena_scope, msg_router按批次使用).
+* 未开启时每次调用在栈上构造消息, 多个io线程派发同一个消息id也是安全的.
+*/
+
+#include <cstddef>
+
+#if defined(NET_USE_PROTOBUF_ARENA)
+#include <google/protobuf/arena.h>
+#endif
+
+namespace net {
+#if defined(NET_USE_PROTOBUF_ARENA)
+	class pb_arena {
+	public:
+		static constexpr std::size_t initial_block_size = 64 * 1024;
+
+		static inline google::protobuf::Arena& get() {
+			thread_local pb_arena arena;
+			return arena.arena_;
+		}
+		static inline std::size_t& depth() {
+			thread_local std::size_t depth = 0;
+			return depth;
+		}
+
+	protected:
+		pb_arena() : arena_(options()) {}
+
+		inline google::protobuf::ArenaOptions options() {
+			google::protobuf::ArenaOptions opts;
+			opts.initial_block = this->block_;
+			opts.initial_block_size = sizeof(this->block_);
+			return opts;
+		}
+
+		alignas(8) char block_[initial_block_size];
+		google::protobuf::Arena arena_;
+	};
+
+	// 批次作用域：作用域内解析的pb消息在作用域结束时一起释放.
+	class pb_arena_scope {
+	public:
+		pb_arena_scope() { ++pb_arena::depth(); }
+		~pb_arena_scope() {
+			if (--pb_arena::depth() == 0)
+				pb_arena::get().Reset();
+		}
+		pb_arena_scope(const pb_arena_scope&) = delete;
+		pb_arena_scope& operator=(const pb_arena_scope&) = delete;
+	};
+
+	// handler里再解析pb消息(嵌套)时只有最外层的作用域重置arena; handler抛异常时也会重置
+	template<class T, class Fn>
+	inline bool pb_parse(const char* buf, std::size_t len, Fn&& fn) {
+		pb_arena_scope scope;
+		T* pcg = google::protobuf::Arena::CreateMessage<T>(&pb_arena::get());
+		if (!pcg->ParseFromArray(buf, static_cast<int>(len)))
+			return false;
+		fn(*pcg);
+		return true;
+	}
+#else
+	class pb_arena_scope {
+	public:
+		pb_arena_scope() = default;
+		pb_arena_scope(const pb_arena_scope&) = delete;
+		pb_arena_scope& operator=(const pb_arena_scope&) = delete;
+	};
+
+	template<class T, class Fn>
+	inline bool pb_parse(const char* buf, std::size_t len, Fn&& fn) {
+		T pcg;
+		if (!pcg.ParseFromArray(buf, static_cast<int>(len)))
+			return false;
+		fn(pcg);
+		return true;
+	}
+#endif
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+/*
+* 最小完美哈希(hash and displace)：用于注册完成后不再变化的字符串id.
+* 键按哈希分到若干桶里, 从大桶开始为每个桶找一个位移值d, 使桶内所有键落到互不冲突的空槽;
+* 查找时只算一次哈希, 再比较一次字符串.
+*	frozen_str_map<V>		运行期构建
+*	static_str_table<N>		编译期构建, 返回键在注册列表中的下标, 可以作为switch的case
+*/
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <string_view>
+
+namespace net {
+	namespace detail {
+		constexpr std::size_t phash_max_bucket = 32;
+		constexpr std::size_t phash_max_seeds = 64;
+
+		constexpr std::uint64_t phash(std::string_view s, std::uint64_t seed) {
+			std::uint64_t h = 14695981039346656037ull ^ seed;
+			for (char c : s) {
+				h ^= static_cast<unsigned char>(c);
+				h *= 1099511628211ull;
+			}
+			return h;
+		}
+		constexpr std::uint64_t phash_mix(std::uint64_t x) {
+			x ^= x >> 30;
+			x *= 0xbf58476d1ce4e5b9ull;
+			x ^= x >> 27;
+			x *= 0x94d049bb133111ebull;
+			x ^= x >> 31;
+			return x;
+		}
+		constexpr std::size_t phash_buckets(std::size_t n) { return n / 4 + 1; }
+		constexpr std::size_t phash_bucket(std::uint64_t h, std::size_t nb) { return static_cast<std::size_t>((h >> 32) % nb); }
+		constexpr std::size_t phash_slot(std::uint64_t h, std::uint32_t d, std::size_t n) {
+			return static_cast<std::size_t>(phash_mix(h + d) % n);
+		}
+
+		// table[slot] = 键下标 + 1, disp[bucket] = 位移值; hashes(n个)和counts(nb个)为临时空间.
+		// 失败(桶过大或者找不到位移值)返回false, 由调用方换种子重试.
+		template<class Keys, class Disp, class Table, class Hashes, class Counts>
+		constexpr bool phash_build(const Keys& keys, std::size_t n, std::uint64_t seed, Disp& disp, std::size_t nb, Table& table,
+			Hashes& hashes, Counts& counts) {
+			for (std::size_t b = 0; b < nb; ++b) {
+				disp[b] = 0;
+				counts[b] = 0;
+			}
+			for (std::size_t i = 0; i < n; ++i) {
+				table[i] = 0;
+				hashes[i] = phash(keys[i], seed);
+				if (++counts[phash_bucket(hashes[i], nb)] > phash_max_bucket)
+					return false;
+			}
+
+			// 从大桶开始处理
+			for (std::size_t size = phash_max_bucket; size > 0; --size) {
+				for (std::size_t b = 0; b < nb; ++b) {
+					if (counts[b] != size)
+						continue;
+					std::size_t members[phash_max_bucket] = {};
+					std::size_t count = 0;
+					for (std::size_t i = 0; i < n && count < size; ++i) {
+						if (phash_bucket(hashes[i], nb) == b)
+							members[count++] = i;
+					}
+
+					bool placed = false;
+					for (std::uint32_t d = 0; d < 8 * n + 64 && !placed; ++d) {
+						std::size_t slots[phash_max_bucket] = {};
+						placed = true;
+						for (std::size_t k = 0; k < count && placed; ++k) {
+							slots[k] = phash_slot(hashes[members[k]], d, n);
+							if (table[slots[k]] != 0)
+								placed = false;
+							for (std::size_t j = 0; j < k && placed; ++j) {
+								if (slots[j] == slots[k])
+									placed = false;
+							}
+						}
+						if (!placed)
+							continue;
+						disp[b] = d;
+						for (std::size_t k = 0; k < count; ++k)
+							table[slots[k]] = static_cast<std::uint32_t>(members[k] + 1);
+					}
+					if (!placed)
+						return false;
+				}
+			}
+			return true;
+		}
+
+		// 编译期构建失败(有重复的键)时, 调用这个非constexpr函数产生编译错误.
+		inline void phash_build_failed() {}
+	}
+
+	template<class V>
+	class frozen_str_map {
+	public:
+		frozen_str_map() = default;
+		~frozen_str_map() = default;
+
+		// 键不能重复
+		inline bool build(std::vector<std::pair<std::string, V>>&& items) {
+			std::size_t n = items.size();
+			this->slots_.clear();
+			this->disp_.clear();
+			if (n == 0)
+				return true;
+
+			std::vector<std::string_view> keys;
+			keys.reserve(n);
+			for (auto& item : items)
+				keys.emplace_back(item.first);
+
+			std::size_t nb = detail::phash_buckets(n);
+			std::vector<std::uint32_t> disp(nb), table(n), counts(nb);
+			std::vector<std::uint64_t> hashes(n);
+			for (std::uint64_t seed = 0; seed < detail::phash_max_seeds; ++seed) {
+				if (!detail::phash_build(keys, n, seed, disp, nb, table, hashes, counts))
+					continue;
+				this->seed_ = seed;
+				this->disp_ = std::move(disp);
+				this->slots_.reserve(n);
+				for (std::size_t slot = 0; slot < n; ++slot)
+					this->slots_.emplace_back(std::move(items[table[slot] - 1]));
+				return true;
+			}
+			return false;
+		}
+
+		inline const V* find(std::string_view key) const {
+			if (this->slots_.empty())
+				return nullptr;
+			std::uint64_t h = detail::phash(key, this->seed_);
+			std::size_t slot = detail::phash_slot(h, this->disp_[detail::phash_bucket(h, this->disp_.size())], this->slots_.size());
+			const auto& item = this->slots_[slot];
+			return (item.first == key) ? &item.second : nullptr;
+		}
+
+		inline std::size_t size() const { return this->slots_.size(); }
+		inline bool empty() const { return this->slots_.empty(); }
+
+	protected:
+		std::uint64_t seed_ = 0;
+		std::vector<std::uint32_t> disp_;
+		std::vector<std::pair<std::string, V>> slots_;
+	};
+
+	template<std::size_t N>
+	class static_str_table {
+	public:
+		static_assert(N > 0, "static_str_table needs at least one key");
+		static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+		static constexpr std::size_t buckets = detail::phash_buckets(N);
+
+		constexpr explicit static_str_table(const std::array<std::string_view, N>& keys) : keys_(keys) {
+			std::array<std::uint64_t, N> hashes{};
+			std::array<std::uint32_t, buckets> counts{};
+			for (std::uint64_t seed = 0; seed < detail::phash_max_seeds; ++seed) {
+				if (detail::phash_build(this->keys_, N, seed, this->disp_, buckets, this->table_, hashes, counts)) {
+					this->seed_ = seed;
+					return;
+				}
+			}
+			detail::phash_build_failed();
+		}
+
+		// 返回键在注册列表中的下标, 不存在返回npos
+		constexpr std::size_t find(std::string_view key) const {
+			std::uint64_t h = detail::phash(key, this->seed_);
+			std::size_t slot = detail::phash_slot(h, this->disp_[detail::phash_bucket(h, buckets)], N);
+			std::size_t index = this->table_[slot] - 1;
+			return (this->keys_[index] == key) ? index : npos;
+		}
+
+		constexpr std::size_t size() const { return N; }
+		constexpr std::string_view key(std::size_t index) const { return this->keys_[index]; }
+
+	protected:
+		std::array<std::string_view, N> keys_{};
+		std::array<std::uint32_t, buckets> disp_{};
+		std::array<std::uint32_t, N> table_{};
+		std::uint64_t seed_ = 0;
+	};
+
+	// constexpr auto cmds = net::make_str_table("login", "logout");
+	// switch (cmds.find(name)) { case cmds.find("login"): ... }
+	template<class... S>
+	constexpr auto make_str_table(S... keys) {
+		return static_str_table<sizeof...(S)>(std::array<std::string_view, sizeof...(S)>{ std::string_view(keys)... });
+	}
+}